@@ -1,20 +1,14 @@
 // directory.cc 
 //	Routines to manage a directory of file names.
 //
-//	The directory is a table of fixed length entries; each
-//	entry represents a single file, and contains the file name,
-//	and the location of the file header on disk.  The fixed size
-//	of each directory entry means that we have the restriction
-//	of a fixed maximum size for file names.
+//	The directory is a linear hash table stored in a file: a header
+//	page holding the size of the table, and one page per bucket,
+//	holding variable length entries.  Each entry gives a file name,
+//	and the location of the file header on disk.
 //
-//	The constructor initializes an empty directory of a certain size;
-//	we use ReadFrom/WriteBack to fetch the contents of the directory
-//	from disk, and to write back any modifications back to disk.
-//
-//	Also, this implementation has the restriction that the size
-//	of the directory cannot expand.  In other words, once all the
-//	entries in the directory are used, no more files can be created.
-//	Fixing this is one of the parts to the assignment.
+//	Buckets are split one at a time, in order, as the directory
+//	fills, and the directory file is extended with addFileSize to
+//	make room for the new bucket.  Removing names never shrinks it.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -24,75 +18,171 @@
 #include "utility.h"
 #include "filehdr.h"
 #include "directory.h"
+#include "system.h"
+
+// Fields of the header of a directory page
+#define PageUsed(page)		(((int *)(page))[0])	// bytes of entries
+#define PageNext(page)		(((int *)(page))[1])	// next on chain
+#define PagePrev(page)		(((int *)(page))[2])	// previous on chain
+
+#define HeaderWords		5	// ints in the header page
 
 //----------------------------------------------------------------------
 // Directory::Directory
-// 	Initialize a directory; initially, the directory is completely
-//	empty.  If the disk is being formatted, an empty directory
-//	is all we need, but otherwise, we need to call FetchFrom in order
-//	to initialize it from disk.
+// 	Initialize a directory, stored in "file", by reading its header
+//	page.  The file must already hold a directory; when the disk is
+//	being formatted, or a new directory made, call Format first.
 //
-//	"size" is the number of entries in the directory
+//	"dirFile" -- file containing the directory contents
 //----------------------------------------------------------------------
 
-Directory::Directory(int size)
+Directory::Directory(OpenFile *dirFile)
 {
-    table = new DirectoryEntry[size];
-    tableSize = size;
-    for (int i = 0; i < tableSize; i++)
-    table[i].inUse = FALSE;
+    int header[HeaderWords];
+
+    file = dirFile;
+    stats->numDirPageReads++;
+    (void) file->ReadAt((char *)header, sizeof(header), 0);
+    numEntries = header[0];
+    level = header[1];
+    split = header[2];
+    numPages = header[3];
+    freeList = header[4];
 }
 
 //----------------------------------------------------------------------
 // Directory::~Directory
-// 	De-allocate directory data structure.
+// 	De-allocate directory data structure.  The directory file stays
+//	open; it belongs to the caller.
 //----------------------------------------------------------------------
 
 Directory::~Directory()
 { 
-    delete [] table;
 } 
 
 //----------------------------------------------------------------------
-// Directory::FetchFrom
-// 	Read the contents of the directory from disk.
-//
-//	"file" -- file containing the directory contents
+// Directory::Format
+// 	Write an empty directory, with InitialBuckets empty buckets, into
+//	"dirFile", which must be at least DirectoryFileSize bytes long.
 //----------------------------------------------------------------------
 
 void
-Directory::FetchFrom(OpenFile *file)
+Directory::Format(OpenFile *dirFile)
 {
-    (void) file->ReadAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    char page[DirPageSize];
+
+    bzero(page, DirPageSize);		// no entries, and no chains
+    for (int i = 1; i <= InitialBuckets; i++)
+	(void) dirFile->WriteAt(page, DirPageSize, i * DirPageSize);
+    ((int *)page)[3] = 1 + InitialBuckets;	// numPages
+    (void) dirFile->WriteAt(page, DirPageSize, 0);
 }
 
 //----------------------------------------------------------------------
-// Directory::WriteBack
-// 	Write any modifications to the directory back to disk
-//
-//	"file" -- file to contain the new directory contents
+// Directory::Hash
+// 	Return a hash value for the first "length" characters of "name"
+//	(FNV-1a), which picks the bucket the name goes in.
+//----------------------------------------------------------------------
+
+unsigned int
+Directory::Hash(char *name, int length)
+{
+    unsigned int hash = 2166136261u;
+
+    for (int i = 0; i < length; i++) {
+	hash ^= (unsigned char) name[i];
+	hash *= 16777619;
+    }
+    return hash;
+}
+
+//----------------------------------------------------------------------
+// Directory::Bucket
+// 	Return the bucket a name with hash value "hash" belongs in.
+//	Buckets below "split" have been split into two already, so for
+//	them one more bit of the hash decides.
+//----------------------------------------------------------------------
+
+int
+Directory::Bucket(unsigned int hash)
+{
+    unsigned int buckets = InitialBuckets << level;
+    int bucket = hash % buckets;
+
+    if (bucket < split)
+	bucket = hash % (2 * buckets);
+    return bucket;
+}
+
+//----------------------------------------------------------------------
+// Directory::ReadPage, WritePage, WriteHeader, SetLink
+// 	Move a page, or the header, between memory and the directory
+//	file.  Bucket "i" is stored in page i + 1; overflow pages go
+//	anywhere after the buckets.
 //----------------------------------------------------------------------
 
 void
-Directory::WriteBack(OpenFile *file)
+Directory::ReadPage(int which, char *page)
 {
-    (void) file->WriteAt((char *)table, tableSize * sizeof(DirectoryEntry), 0);
+    stats->numDirPageReads++;
+    (void) file->ReadAt(page, DirPageSize, which * DirPageSize);
+}
+
+void
+Directory::WritePage(int which, char *page)
+{
+    (void) file->WriteAt(page, DirPageSize, which * DirPageSize);
+}
+
+void
+Directory::WriteHeader()
+{
+    int header[HeaderWords];
+
+    header[0] = numEntries;
+    header[1] = level;
+    header[2] = split;
+    header[3] = numPages;
+    header[4] = freeList;
+    (void) file->WriteAt((char *)header, sizeof(header), 0);
+}
+
+void
+Directory::SetLink(int which, int field, int value)
+{
+    (void) file->WriteAt((char *)&value, sizeof(int), 
+			which * DirPageSize + field * sizeof(int));
 }
 
 //----------------------------------------------------------------------
-// Directory::FindIndex
-// 	Look up file name in directory, and return its location in the table of
-//	directory entries.  Return -1 if the name isn't in the directory.
+// Directory::FindEntry
+// 	Look up file name in directory, and return the offset of its
+//	entry in the page that holds it, leaving the page in "page", and
+//	its number in "which".  Return -1 if the name isn't in the 
+//	directory.
 //
 //	"name" -- the file name to look up
 //----------------------------------------------------------------------
 
 int
-Directory::FindIndex(char *name)
+Directory::FindEntry(char *name, char *page, int *which)
 {
-    for (int i = 0; i < tableSize; i++)
-        if (table[i].inUse && !strncmp(table[i].name, name, FileNameMaxLen))
-	    return i;
+    int length = strlen(name);
+    int offset, nameLength;
+
+    if (length > FileNameMaxLen)
+	return -1;
+    for (*which = Bucket(Hash(name, length)) + 1; *which != 0; 
+	    *which = PageNext(page)) {
+	ReadPage(*which, page);
+	for (offset = DirPageHeader; offset < DirPageHeader + PageUsed(page); 
+		offset += DirEntryHeader + nameLength) {
+	    nameLength = (unsigned char) page[offset + 5];
+	    if (nameLength == length && 
+		    !strncmp(&page[offset + DirEntryHeader], name, length))
+		return offset;
+	}
+    }
     return -1;		// name not in directory
 }
 
@@ -103,60 +193,312 @@ Directory::FindIndex(char *name)
 //	in the directory.
 //
 //	"name" -- the file name to look up
+//	"type" -- if not NULL, set to 'f' or 'd', if the name is found
 //----------------------------------------------------------------------
 
 int
-Directory::Find(char *name)
+Directory::Find(char *name, char *type)
 {
-    int i = FindIndex(name);
+    char page[DirPageSize];
+    int which, sector;
+    int i = FindEntry(name, page, &which);
 
-    if (i != -1)
-	return table[i].sector;
-    return -1;
+    if (i == -1)
+	return -1;
+    bcopy(&page[i], (char *)&sector, sizeof(int));
+    if (type != NULL)
+	*type = page[i + 4];
+    return sector;
 }
 
 int
 Directory::FindDirectory(char *name)
 {
-    int i = FindIndex(name);
+    char page[DirPageSize];
+    int which, sector;
+    int i = FindEntry(name, page, &which);
+
+    if (i == -1 || page[i + 4] != 'd')
+	return -1;
+    bcopy(&page[i], (char *)&sector, sizeof(int));
+    return sector;
+}
+
+//----------------------------------------------------------------------
+// Directory::Grow
+// 	Make sure the directory file is at least "pages" pages long,
+//	growing it out of "freeMap".  Return FALSE if the disk is full.
+//----------------------------------------------------------------------
+
+bool
+Directory::Grow(BitMap *freeMap, int pages)
+{
+    int needed = pages * DirPageSize;
+
+    if (file->Length() >= needed)
+	return TRUE;
+    if (!file->hdr->addFileSize(freeMap, needed - file->Length()))
+	return FALSE;
+    file->updateHeader();
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Directory::AllocPage, FreePage
+// 	Manage the overflow pages.  Free pages are kept on a doubly
+//	linked list, so that ClaimPage can take one out of the middle.
+//	AllocPage returns the page number, or -1 if the disk is full.
+//----------------------------------------------------------------------
+
+int
+Directory::AllocPage(BitMap *freeMap)
+{
+    char page[DirPageSize];
+    int which = freeList;
+
+    if (which != 0) {
+	ReadPage(which, page);
+	freeList = PageNext(page);
+	if (freeList != 0)
+	    SetLink(freeList, 2, 0);
+	return which;
+    }
+    if (!Grow(freeMap, numPages + 1))
+	return -1;
+    return numPages++;
+}
+
+void
+Directory::FreePage(int which, char *page)
+{
+    PageUsed(page) = -1;
+    PageNext(page) = freeList;
+    PagePrev(page) = 0;
+    WritePage(which, page);
+    if (freeList != 0)
+	SetLink(freeList, 2, which);
+    freeList = which;
+}
+
+//----------------------------------------------------------------------
+// Directory::ClaimPage
+// 	Make page "which", the one after the last bucket, available for
+//	a new bucket.  If it is free, take it off the free list; if it 
+//	is some bucket's overflow page, move that elsewhere.  Return 
+//	FALSE if there is no room on the disk to do so.
+//----------------------------------------------------------------------
+
+bool
+Directory::ClaimPage(BitMap *freeMap, int which)
+{
+    char page[DirPageSize];
+    int moved;
+
+    if (which == numPages) {		// past the end: just extend
+	if (!Grow(freeMap, numPages + 1))
+	    return FALSE;
+	numPages++;
+	return TRUE;
+    }
+
+    ReadPage(which, page);
+    if (PageUsed(page) == -1) {
+	if (PagePrev(page) == 0)
+	    freeList = PageNext(page);
+	else
+	    SetLink(PagePrev(page), 1, PageNext(page));
+	if (PageNext(page) != 0)
+	    SetLink(PageNext(page), 2, PagePrev(page));
+	return TRUE;
+    }
+
+    moved = AllocPage(freeMap);
+    if (moved == -1)
+	return FALSE;
+    WritePage(moved, page);
+    SetLink(PagePrev(page), 1, moved);
+    if (PageNext(page) != 0)
+	SetLink(PageNext(page), 2, moved);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Directory::Append
+// 	Add an entry at the end of the chain whose last page is "page",
+//	page number "*which", starting a new overflow page if it doesn't
+//	fit.  The page isn't written back until it is full; the caller
+//	writes the last one.
+//----------------------------------------------------------------------
+
+void
+Directory::Append(int *which, char *page, char *entry, int size, 
+		BitMap *freeMap)
+{
+    int next;
+
+    if (DirPageHeader + PageUsed(page) + size > DirPageSize) {
+	next = AllocPage(freeMap);
+	ASSERT(next != -1);		// the caller made sure of room
+	PageNext(page) = next;
+	WritePage(*which, page);
+	PageUsed(page) = 0;
+	PageNext(page) = 0;
+	PagePrev(page) = *which;
+	*which = next;
+    }
+    bcopy(entry, &page[DirPageHeader + PageUsed(page)], size);
+    PageUsed(page) += size;
+}
+
+//----------------------------------------------------------------------
+// Directory::Split
+// 	Split bucket "split" in two, moving the names whose hash has the
+//	next bit set into a new bucket at the end of the table.  Grow the
+//	directory file first, if the new bucket doesn't fit.  Return 
+//	FALSE if there is no room on the disk for it.
+//
+//	"freeMap" -- the bit map of free disk sectors, to grow the file
+//----------------------------------------------------------------------
+
+bool
+Directory::Split(BitMap *freeMap)
+{
+    char page[DirPageSize], low[DirPageSize], high[DirPageSize];
+    unsigned int buckets = InitialBuckets << level;
+    int newBucket = split + buckets;
+    int lowPage = split + 1, highPage = newBucket + 1;
+    int chain = 0, bytes = 0, offset, size, which;
+    int lowUsed = 0, highUsed = 0, overflow = 0, next;
+    char *entries;
+    bool toLow, claimed;
+
+    if (!Grow(freeMap, numPages + 2))	// room to claim the new page
+	return FALSE;
+    claimed = ClaimPage(freeMap, highPage);
+    ASSERT(claimed);
+
+    // Read in the whole chain, freeing its overflow pages
+    for (which = lowPage; which != 0; which = PageNext(page)) {
+	ReadPage(which, page);
+	chain++;
+    }
+    entries = new char[chain * DirPageSize];
+    for (which = lowPage; which != 0; which = next) {
+	ReadPage(which, page);
+	bcopy(&page[DirPageHeader], &entries[bytes], PageUsed(page));
+	bytes += PageUsed(page);
+	next = PageNext(page);
+	if (which != lowPage)
+	    FreePage(which, page);
+    }
 
-    if (i != -1 && table[i].entryType == 'd')
-    return table[i].sector;
-    return -1;
+    // Count the overflow pages the two halves need, and make sure
+    // there will be room for them
+    for (offset = 0; offset < bytes; offset += size) {
+	size = DirEntryHeader + (unsigned char) entries[offset + 5];
+	toLow = (Hash(&entries[offset + DirEntryHeader], 
+		size - DirEntryHeader) % (2 * buckets) == (unsigned int) split);
+	int *used = toLow ? &lowUsed : &highUsed;
+	if (DirPageHeader + *used + size > DirPageSize) {
+	    overflow++;
+	    *used = 0;
+	}
+	*used += size;
+    }
+    if (!Grow(freeMap, numPages + overflow)) {
+	// put the entries back the way they were
+	ReadPage(lowPage, low);
+	PageUsed(low) = PageNext(low) = 0;
+	for (offset = 0; offset < bytes; offset += size) {
+	    size = DirEntryHeader + (unsigned char) entries[offset + 5];
+	    Append(&lowPage, low, &entries[offset], size, freeMap);
+	}
+	WritePage(lowPage, low);
+	bzero(page, DirPageSize);
+	FreePage(highPage, page);
+	delete [] entries;
+	WriteHeader();
+	return FALSE;
+    }
+
+    // Write the two halves
+    PageUsed(low) = PageNext(low) = PagePrev(low) = 0;
+    PageUsed(high) = PageNext(high) = PagePrev(high) = 0;
+    for (offset = 0; offset < bytes; offset += size) {
+	size = DirEntryHeader + (unsigned char) entries[offset + 5];
+	if (Hash(&entries[offset + DirEntryHeader], size - DirEntryHeader) 
+		% (2 * buckets) == (unsigned int) split)
+	    Append(&lowPage, low, &entries[offset], size, freeMap);
+	else
+	    Append(&highPage, high, &entries[offset], size, freeMap);
+    }
+    WritePage(lowPage, low);
+    WritePage(highPage, high);
+    delete [] entries;
+
+    if (++split == (int) buckets) {	// every bucket split: the table
+	level++;			// has doubled
+	split = 0;
+    }
+    WriteHeader();
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
 // Directory::Add
 // 	Add a file into the directory.  Return TRUE if successful;
-//	return FALSE if the file name is already in the directory, or if
-//	the directory is completely full, and has no more space for
-//	additional file names.
+//	return FALSE if the file name is already in the directory, if
+//	the name is too long, or if the directory needs to grow, and
+//	there is no room on the disk for it to do so.
 //
 //	"name" -- the name of the file being added
 //	"newSector" -- the disk sector containing the added file's header
+//	"type" -- 'f' for a file, 'd' for a directory
+//	"freeMap" -- the bit map of free disk sectors, to grow the file
 //----------------------------------------------------------------------
 
 bool
-Directory::Add(char *name, int newSector, char type)
+Directory::Add(char *name, int newSector, char type, BitMap *freeMap)
 { 
-    if (FindIndex(name) != -1)
+    char page[DirPageSize], entry[DirPageSize];
+    int length = strlen(name);
+    int size = DirEntryHeader + length;
+    int which;
+
+    if (length > FileNameMaxLen || FindEntry(name, page, &which) != -1)
 	return FALSE;
 
-    for (int i = 0; i < tableSize; i++)
-        if (!table[i].inUse) {
-            table[i].inUse = TRUE;
-            strncpy(table[i].name, name, FileNameMaxLen); 
-            table[i].sector = newSector;
-            table[i].entryType = type;
-        return TRUE;
-	}
-    return FALSE;	// no space.  Fix when we have extensible files.
+    // find room on the bucket's chain, or add a page to it
+    for (which = Bucket(Hash(name, length)) + 1; ; which = PageNext(page)) {
+	ReadPage(which, page);
+	if (DirPageHeader + PageUsed(page) + size <= DirPageSize || 
+		PageNext(page) == 0)
+	    break;
+    }
+    if (DirPageHeader + PageUsed(page) + size > DirPageSize && 
+	    !Grow(freeMap, numPages + 1))
+	return FALSE;			// no room for an overflow page
+
+    bcopy((char *)&newSector, entry, sizeof(int));
+    entry[4] = type;
+    entry[5] = length;
+    bcopy(name, &entry[DirEntryHeader], length);
+    Append(&which, page, entry, size, freeMap);
+    WritePage(which, page);
+
+    numEntries++;
+    if (numEntries > DirMaxLoad * NumBuckets())
+	(void) Split(freeMap);		// if the disk is full, the buckets
+					// just get fuller
+    WriteHeader();
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
 // Directory::Remove
 // 	Remove a file name from the directory.  Return TRUE if successful;
-//	return FALSE if the file isn't in the directory. 
+//	return FALSE if the file isn't in the directory.  An overflow 
+//	page that empties is unlinked, and put on the free list.
 //
 //	"name" -- the file name to be removed
 //----------------------------------------------------------------------
@@ -164,11 +506,27 @@ Directory::Add(char *name, int newSector, char type)
 bool
 Directory::Remove(char *name)
 { 
-    int i = FindIndex(name);
+    char page[DirPageSize];
+    int which, size, end;
+    int i = FindEntry(name, page, &which);
 
     if (i == -1)
 	return FALSE; 		// name not in directory
-    table[i].inUse = FALSE;
+
+    size = DirEntryHeader + strlen(name);
+    end = DirPageHeader + PageUsed(page);
+    bcopy(&page[i + size], &page[i], end - (i + size));
+    PageUsed(page) -= size;
+    if (PageUsed(page) == 0 && PagePrev(page) != 0) {
+	SetLink(PagePrev(page), 1, PageNext(page));
+	if (PageNext(page) != 0)
+	    SetLink(PageNext(page), 2, PagePrev(page));
+	FreePage(which, page);
+    } else
+	WritePage(which, page);
+
+    numEntries--;
+    WriteHeader();
     return TRUE;	
 }
 
@@ -180,9 +538,20 @@ Directory::Remove(char *name)
 void
 Directory::List()
 {
-   for (int i = 0; i < tableSize; i++)
-	if (table[i].inUse)
-	    printf("%s\n", table[i].name);
+    char page[DirPageSize];
+    int offset, length;
+
+    for (int b = 0; b < NumBuckets(); b++) {
+	for (int which = b + 1; which != 0; which = PageNext(page)) {
+	    ReadPage(which, page);
+	    for (offset = DirPageHeader; 
+		    offset < DirPageHeader + PageUsed(page);
+		    offset += DirEntryHeader + length) {
+		length = (unsigned char) page[offset + 5];
+		printf("%.*s\n", length, &page[offset + DirEntryHeader]);
+	    }
+	}
+    }
 }
 
 //----------------------------------------------------------------------
@@ -195,14 +564,218 @@ void
 Directory::Print()
 { 
     FileHeader *hdr = new FileHeader;
+    char page[DirPageSize];
+    int offset, length, sector;
 
-    printf("Directory contents:\n");
-    for (int i = 0; i < tableSize; i++)
-	if (table[i].inUse) {
-	    printf("Name: %s, Sector: %d, type: %c\n", table[i].name, table[i].sector, table[i].entryType);
-	    hdr->FetchFrom(table[i].sector);
-	    hdr->Print();
+    printf("Directory contents: %d names in %d buckets\n", numEntries,
+	NumBuckets());
+    for (int b = 0; b < NumBuckets(); b++) {
+	for (int which = b + 1; which != 0; which = PageNext(page)) {
+	    ReadPage(which, page);
+	    for (offset = DirPageHeader; 
+		    offset < DirPageHeader + PageUsed(page);
+		    offset += DirEntryHeader + length) {
+		length = (unsigned char) page[offset + 5];
+		bcopy(&page[offset], (char *)&sector, sizeof(int));
+		printf("Name: %.*s, Sector: %d, type: %c\n", length, 
+		    &page[offset + DirEntryHeader], sector, page[offset + 4]);
+		hdr->FetchFrom(sector);
+		hdr->Print();
+	    }
 	}
+    }
     printf("\n");
     delete hdr;
 }
+
+//----------------------------------------------------------------------
+// DentryCache::DentryCache
+// 	Initialize an empty dentry cache.  Every dentry starts out
+//	unused, on the LRU list but in no hash bucket.
+//
+//	"size" -- the number of lookups to remember
+//----------------------------------------------------------------------
+
+DentryCache::DentryCache(int size)
+{
+    ASSERT(size > 0);
+    numDentries = size;
+    dentries = new Dentry[size];
+    hashTable = new Dentry *[size];
+    for (int i = 0; i < size; i++) {
+	hashTable[i] = NULL;
+	dentries[i].parent = -1;
+	dentries[i].hashNext = NULL;
+	dentries[i].lruPrev = (i > 0) ? &dentries[i - 1] : NULL;
+	dentries[i].lruNext = (i < size - 1) ? &dentries[i + 1] : NULL;
+    }
+    lruHead = &dentries[0];
+    lruTail = &dentries[size - 1];
+}
+
+//----------------------------------------------------------------------
+// DentryCache::~DentryCache
+// 	De-allocate the dentry cache.
+//----------------------------------------------------------------------
+
+DentryCache::~DentryCache()
+{
+    delete [] dentries;
+    delete [] hashTable;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Lookup
+// 	If looking up "name" in the directory whose header is in sector
+//	"parent" has been cached, set "sector" and "type" to the result
+//	(sector -1 if the name isn't there), and return TRUE.  Return 
+//	FALSE if the directory has to be searched.
+//----------------------------------------------------------------------
+
+bool
+DentryCache::Lookup(int parent, char *name, int *sector, char *type)
+{
+    Dentry *dentry = Find(parent, name);
+
+    if (dentry == NULL) {
+	stats->numDentryMisses++;
+	return FALSE;
+    }
+    stats->numDentryHits++;
+    MoveToFront(dentry);
+    *sector = dentry->sector;
+    *type = dentry->type;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Enter
+// 	Cache the result of looking up "name" in directory "parent",
+//	replacing what was cached before, or else the least recently
+//	used dentry.  Names too long to be in a directory aren't cached.
+//
+//	"sector" -- the file header "name" refers to, -1 if none
+//	"type" -- 'f' or 'd'
+//----------------------------------------------------------------------
+
+void
+DentryCache::Enter(int parent, char *name, int sector, char type)
+{
+    Dentry *dentry = Find(parent, name);
+    Dentry **bucket;
+
+    if ((int) strlen(name) > FileNameMaxLen)
+	return;
+    if (dentry == NULL) {
+	dentry = lruTail;
+	if (dentry->parent != -1)
+	    HashRemove(dentry);
+	dentry->parent = parent;
+	strcpy(dentry->name, name);
+	bucket = Bucket(parent, name);
+	dentry->hashNext = *bucket;
+	*bucket = dentry;
+    }
+    dentry->sector = sector;
+    dentry->type = type;
+    MoveToFront(dentry);
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Purge
+// 	Forget every lookup in the directory whose header is in sector 
+//	"parent", because the directory is going away, and its sector
+//	may be reused.  The dentries freed go to the LRU end of the list.
+//----------------------------------------------------------------------
+
+void
+DentryCache::Purge(int parent)
+{
+    Dentry *dentry;
+
+    for (int i = 0; i < numDentries; i++) {
+	dentry = &dentries[i];
+	if (dentry->parent != parent)
+	    continue;
+	HashRemove(dentry);
+	dentry->parent = -1;
+	if (dentry == lruTail)
+	    continue;
+	if (dentry == lruHead)			// unlink ...
+	    lruHead = dentry->lruNext;
+	else
+	    dentry->lruPrev->lruNext = dentry->lruNext;
+	dentry->lruNext->lruPrev = dentry->lruPrev;
+	dentry->lruPrev = lruTail;		// ... and put at the tail
+	dentry->lruNext = NULL;
+	lruTail->lruNext = dentry;
+	lruTail = dentry;
+    }
+}
+
+//----------------------------------------------------------------------
+// DentryCache::Bucket, Find
+// 	Locate the hash bucket for a lookup, and the dentry caching it,
+//	if any.
+//----------------------------------------------------------------------
+
+Dentry **
+DentryCache::Bucket(int parent, char *name)
+{
+    unsigned int hash = Directory::Hash(name, strlen(name)) + parent * 31;
+
+    return &hashTable[hash % numDentries];
+}
+
+Dentry *
+DentryCache::Find(int parent, char *name)
+{
+    Dentry *dentry;
+
+    for (dentry = *Bucket(parent, name); dentry != NULL; 
+	    dentry = dentry->hashNext)
+	if (dentry->parent == parent && !strcmp(dentry->name, name))
+	    return dentry;
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::HashRemove
+// 	Unlink a dentry from its hash bucket.
+//----------------------------------------------------------------------
+
+void
+DentryCache::HashRemove(Dentry *dentry)
+{
+    Dentry **ptr = Bucket(dentry->parent, dentry->name);
+
+    while (*ptr != dentry) {
+	ASSERT(*ptr != NULL);
+	ptr = &(*ptr)->hashNext;
+    }
+    *ptr = dentry->hashNext;
+    dentry->hashNext = NULL;
+}
+
+//----------------------------------------------------------------------
+// DentryCache::MoveToFront
+// 	Move a dentry to the head of the LRU list.
+//----------------------------------------------------------------------
+
+void
+DentryCache::MoveToFront(Dentry *dentry)
+{
+    if (dentry == lruHead)
+	return;
+
+    dentry->lruPrev->lruNext = dentry->lruNext;	// unlink
+    if (dentry == lruTail)
+	lruTail = dentry->lruPrev;
+    else
+	dentry->lruNext->lruPrev = dentry->lruPrev;
+
+    dentry->lruPrev = NULL;			// and push at the head
+    dentry->lruNext = lruHead;
+    lruHead->lruPrev = dentry;
+    lruHead = dentry;
+}
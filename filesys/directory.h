@@ -17,54 +17,71 @@
 #ifndef DIRECTORY_H
 #define DIRECTORY_H
 
+#include "disk.h"
 #include "openfile.h"
+#include "bitmap.h"
 
-#define Direcotry
-#define FileNameMaxLen 		20	// for simplicity, we assume 
-					// file names are <= 9 characters long
-
-// The following class defines a "directory entry", representing a file
-// in the directory.  Each entry gives the name of the file, and where
-// the file's header is to be found on disk.
+// A directory file is a header page, followed by one page per hash
+// bucket, and by overflow pages for buckets that don't fit in one.  A
+// page is a disk sector, so that looking up a name usually costs two
+// sector reads, however big the directory is.
 //
-// Internal data structures kept public so that Directory operations can
-// access them directly.
+// Each page starts with the number of bytes of entries in it (-1 if
+// the page is free), and the pages before and after it on its chain
+// (0 for none), followed by the entries, packed one after the other:
+//	sector of the file header	(4 bytes)
+//	entry type, 'f' or 'd'		(1 byte)
+//	length of the name		(1 byte)
+//	the name, without a trailing '\0'
 
-class DirectoryEntry {
-  public:
-    bool inUse;				// Is this directory entry in use?
-    int sector;				// Location on disk to find the 
-					//   FileHeader for this file 
-    char entryType;             //'f' means file, and 'd' means direcotry
-    char name[FileNameMaxLen + 1];	// Text name for file, with +1 for 
-					// the trailing '\0'
-};
+#define DirPageSize		SectorSize
+#define DirPageHeader		(3 * (int) sizeof(int))	// used, next, prev
+#define DirEntryHeader		6	// sector, type and name length
+#define FileNameMaxLen 		(DirPageSize - DirPageHeader - DirEntryHeader)
+					// so that any name fits in a page
+
+#define InitialBuckets		4	// buckets in a new directory
+#define DirMaxLoad		4	// split once the directory holds
+					// more entries than this per bucket
+#define DirectoryFileSize 	((1 + InitialBuckets) * DirPageSize)
+					// size of a new directory file
 
 // The following class defines a UNIX-like "directory".  Each entry in
 // the directory describes a file, and where to find it on disk.
 //
-// The directory data structure can be stored in memory, or on disk.
-// When it is on disk, it is stored as a regular Nachos file.
+// The directory is stored on disk as a regular Nachos file, organized
+// as a linear hash table: the names hash into buckets, and the table
+// grows a bucket at a time, splitting the buckets in order (and growing
+// the file with addFileSize), so that buckets hold DirMaxLoad names on
+// average.  Names that don't fit in their bucket's page go on a chain
+// of overflow pages, until the bucket's turn to be split comes.
 //
-// The constructor initializes a directory structure in memory; the
-// FetchFrom/WriteBack operations shuffle the directory information
-// from/to disk. 
+// A Directory object works directly on the file: each operation reads
+// and writes just the pages it needs, so there is nothing to fetch
+// beforehand or to write back afterwards.
 
 class Directory {
   public:
-    Directory(int size);       // Initialize an empty directory
-					// with space for "size" files
+    Directory(OpenFile *dirFile);	// Use the directory in "dirFile"
     ~Directory();			// De-allocate the directory
 
-    void FetchFrom(OpenFile *file);  	// Init directory contents from disk
-    void WriteBack(OpenFile *file);	// Write modifications to 
-					// directory contents back to disk
+    static void Format(OpenFile *dirFile);  // Write an empty directory
+					// into "dirFile", DirectoryFileSize
+					// long
+    static unsigned int Hash(char *name, int length);
+					// Hash the first "length" bytes
+					// of "name"
 
-    int Find(char *name);		// Find the sector number of the 
-					// FileHeader for file: "name"
+    int Find(char *name, char *type = NULL);
+					// Find the sector number of the
+					// FileHeader for file: "name",
+					// and whether it is a directory
     int FindDirectory(char *name);      //Find the sector number of the directory
 
-    bool Add(char *name, int newSector, char type);  // Add a file name into the directory
+    bool Add(char *name, int newSector, char type, BitMap *freeMap);
+					// Add a file name into the
+					// directory, growing it out of
+					// "freeMap" if need be
 
     bool Remove(char *name);		// Remove a file from the directory
 
@@ -74,12 +91,92 @@ class Directory {
 					//  of the directory -- all the file
 					//  names and their contents.
   private:
-    int tableSize;			// Number of directory entries
-    DirectoryEntry *table;		// Table of pairs: 
-					// <file name, file header location> 
+    OpenFile *file;			// where the directory is stored
+    int numEntries;			// Number of names in the directory
+    int level;				// the table has doubled "level"
+					// times ...
+    int split;				// ... and buckets below "split"
+					// have been split once more
+    int numPages;			// pages of the file in use
+    int freeList;			// first free page, or 0
+
+    int NumBuckets() { return (InitialBuckets << level) + split; }
+    int Bucket(unsigned int hash);	// which bucket "hash" falls into
+    void ReadPage(int which, char *page);
+    void WritePage(int which, char *page);
+    void WriteHeader();			// Write the table size and free
+					// list back to the header page
+    void SetLink(int which, int field, int value);
+					// Change one link in a page
+
+    int FindEntry(char *name, char *page, int *which);
+					// Read the page holding "name"
+    bool Grow(BitMap *freeMap, int pages);  // Make the file "pages" long
+    int AllocPage(BitMap *freeMap);	// Take a page off the free list,
+					// or from the end of the file
+    void FreePage(int which, char *page);  // Put a page on the free list
+    bool ClaimPage(BitMap *freeMap, int which);
+					// Free up page "which" for a bucket
+    void Append(int *which, char *page, char *entry, int size, 
+		BitMap *freeMap);	// Add an entry at the end of a chain
+    bool Split(BitMap *freeMap);	// Split the next bucket in order
+};
+
+// A dentry caches the result of looking up one name in one directory:
+// the sector of the file header it names, or -1 if the name is known
+// not to be there (a "negative" entry).  Dentries are chained into a
+// hash bucket (for lookup by directory and name) and into a doubly
+// linked LRU list (most recently used at the head).
+
+#define DefaultDentries		64	// names kept in the dentry cache
+
+class Dentry {
+  public:
+    int parent;				// sector of the directory searched,
+					// -1 if the dentry is unused
+    char name[FileNameMaxLen + 1];	// name looked up
+    int sector;				// what it names, -1 if nothing
+    char type;				// 'f' or 'd', if it names something
+    Dentry *hashNext;			// next dentry in the same bucket
+    Dentry *lruPrev;			// towards the most recently used
+    Dentry *lruNext;			// towards the least recently used
+};
+
+// The dentry cache remembers recent name lookups, so that resolving
+// a path whose directories have been searched before reads no
+// directory pages at all.  Whoever changes a directory has to keep the
+// cache in step (by calling Enter with the new answer), and has to 
+// Purge a directory whose sector may be reused.
+//
+// As with Directory, we assume mutual exclusion is provided by the
+// caller.
+
+class DentryCache {
+  public:
+    DentryCache(int size);		// Initialize an empty cache of
+					// "size" dentries
+    ~DentryCache();
+
+    bool Lookup(int parent, char *name, int *sector, char *type);
+					// If the lookup of "name" in 
+					// directory "parent" is cached,
+					// return TRUE and its result
+    void Enter(int parent, char *name, int sector, char type);
+					// Cache the result of a lookup;
+					// "sector" -1 for a negative entry
+    void Purge(int parent);		// Forget all lookups in directory
+					// "parent"
+
+  private:
+    int numDentries;			// size of the cache
+    Dentry *dentries;			// the dentries
+    Dentry **hashTable;			// buckets, by parent and name
+    Dentry *lruHead, *lruTail;		// most/least recently used dentry
 
-    int FindIndex(char *name);		// Find the index into the directory 
-					//  table corresponding to "name"
+    Dentry **Bucket(int parent, char *name);
+    Dentry *Find(int parent, char *name);
+    void HashRemove(Dentry *dentry);
+    void MoveToFront(Dentry *dentry);	// mark dentry most recently used
 };
 
 #endif // DIRECTORY_H
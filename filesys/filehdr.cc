@@ -3,12 +3,9 @@
 //	would be called the i-node).
 //
 //	The file header is used to locate where on disk the 
-//	file's data is stored.  We implement this as a fixed size
-//	table of pointers -- each entry in the table points to the 
-//	disk sector containing that portion of the file data
-//	(in other words, there are no indirect or doubly indirect 
-//	blocks). The table size is chosen so that the file header
-//	will be just big enough to fit in one disk sector, 
+//	file's data is stored.  We implement this as a chain of index
+//	sectors, each holding a table of extents -- runs of consecutive
+//	disk sectors holding consecutive parts of the file data.
 //
 //      Unlike in a real system, we do not keep track of file permissions, 
 //	ownership, last modification date, etc., in the file header. 
@@ -27,6 +24,37 @@
 #include "system.h"
 #include "filehdr.h"
 
+// Number of index sectors needed to describe a file of "extents" 
+// extents.  Every file owns at least one, even when it is empty.
+#define IndexSectorsFor(extents) \
+	(((extents) == 0) ? 1 : divRoundUp((extents), ExtentsPerIndex))
+
+#define NextIndexLink	(SectorSize / sizeof(int) - 1)	// where in an index
+					// sector the next one is named
+
+//----------------------------------------------------------------------
+// FileHeader::FileHeader
+// 	Initialize an in-memory file header.  Nothing is read from disk,
+//	and the sector map is loaded lazily the first time it is needed.
+//----------------------------------------------------------------------
+
+FileHeader::FileHeader()
+{
+    extentStart = extentLength = extentOffset = NULL;
+    indexSectors = NULL;
+    mapExtents = 0;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::~FileHeader
+// 	De-allocate the in-memory sector map.
+//----------------------------------------------------------------------
+
+FileHeader::~FileHeader()
+{
+    FreeSectorMap();
+}
+
 //----------------------------------------------------------------------
 // FileHeader::Allocate
 // 	Initialize a fresh file header for a newly created file.
@@ -34,8 +62,11 @@
 //	Return FALSE if there are not enough free blocks to accomodate
 //	the new file.
 //
+//	The sector map is built as the sectors are handed out, so a newly
+//	created file never has to read its own index chain back.
+//
 //	"freeMap" is the bit map of free disk sectors
-//	"fileSize" is the bit map of free disk sectors
+//	"fileSize" is the number of bytes in the file
 //----------------------------------------------------------------------
 
 bool
@@ -50,21 +81,20 @@ FileHeader::Allocate(BitMap *freeMap, int fileSize)
 
     numBytes = fileSize;
     numSectors  = divRoundUp(fileSize, SectorSize);
-    if (freeMap->NumClear() < (numSectors + NumDirect-1)/(NumDirect)*(NumDirect+1) )
-	return FALSE;		// not enough space
+    numExtents = 0;
+    if (freeMap->NumClear() < numSectors + IndexSectorsFor(numSectors))
+	return FALSE;		// not enough space, should every sector
+				// be an extent of its own
     
-    this->firstIndexSector = freeMap->Find();
+    FreeSectorMap();
+    GrowSectorMap(0);
 
-    int buf[NumDirect+1];
-    int indexSector = this->firstIndexSector;
-    for (int i = 0; i < numSectors; i++) {
-	   buf[i%NumDirect] = freeMap->Find();
-       if (i%NumDirect == NumDirect-1 || i == numSectors-1) {
-            if (i != numSectors-1) buf[NumDirect] = freeMap->Find();
-            synchDisk->WriteSector(indexSector, (char *)buf);
-            indexSector = buf[NumDirect];
-       }
-    }
+    this->firstIndexSector = freeMap->Find();
+    indexSectors[0] = this->firstIndexSector;
+    numSectors = 0;
+    AddSectors(freeMap, divRoundUp(fileSize, SectorSize));
+    for (int i = 0; i < IndexSectorsFor(numExtents); i++)
+        WriteIndexSector(i);
     return TRUE;
 }
 
@@ -78,21 +108,14 @@ FileHeader::Allocate(BitMap *freeMap, int fileSize)
 void 
 FileHeader::Deallocate(BitMap *freeMap)
 {
-    int indexSector = this->firstIndexSector;
-    int buf[NumDirect+1];
-    synchDisk->ReadSector(indexSector, (char *)buf);
-    freeMap->Clear(indexSector);
-
-    for (int i = 0; i < numSectors; i++) {
-    	int sector = buf[i%NumDirect];
-        freeMap->Clear(sector);
-
-        if (i%NumDirect == NumDirect-1 && i != numSectors-1) {
-            indexSector = buf[NumDirect];
-            synchDisk->ReadSector(indexSector, (char *)buf);
-            freeMap->Clear(indexSector);
-        } 
-    }
+    LoadSectorMap();
+
+    for (int i = 0; i < IndexSectorsFor(numExtents); i++)
+        freeMap->Clear(indexSectors[i]);
+    for (int i = 0; i < numExtents; i++)
+        freeMap->ClearRun(extentStart[i], extentLength[i]);
+
+    FreeSectorMap();
 }
 
 //----------------------------------------------------------------------
@@ -105,6 +128,7 @@ FileHeader::Deallocate(BitMap *freeMap)
 void
 FileHeader::FetchFrom(int sector)
 {
+    FreeSectorMap();			// the map belongs to the old contents
     synchDisk->ReadSector(sector, (char *)this);
 }
 
@@ -128,23 +152,29 @@ FileHeader::WriteBack(int sector)
 //	offset in the file) to a physical address (the sector where the
 //	data at the offset is stored).
 //
+//	The first call walks the index chain once to fill in the sector
+//	map; every later call is a binary search of the extents.
+//
 //	"offset" is the location within the file of the byte in question
 //----------------------------------------------------------------------
 
 int
 FileHeader::ByteToSector(int offset)
 {
-    int indexSector = this->firstIndexSector;
     int sector = offset/SectorSize;
-    int buf[NumDirect+1];
-    while (1>0) {
-        synchDisk->ReadSector(indexSector, (char *)buf);
-        if (sector < NumDirect) {
-            return buf[sector];
-        }
-        sector -= NumDirect;
-        indexSector = buf[NumDirect];
+    int low = 0, high, middle;
+
+    LoadSectorMap();
+    ASSERT(sector >= 0 && sector < numSectors);
+    high = numExtents - 1;		// find the last extent starting
+    while (low < high) {		// at or before "sector"
+	middle = (low + high + 1) / 2;
+	if (extentOffset[middle] <= sector)
+	    low = middle;
+	else
+	    high = middle - 1;
     }
+    return extentStart[low] + (sector - extentOffset[low]);
 }
 
 //----------------------------------------------------------------------
@@ -167,17 +197,17 @@ FileHeader::FileLength()
 void
 FileHeader::Print()
 {
-    /*
     int i, j, k;
     char *data = new char[SectorSize];
 
-    printf("FileHeader contents.  File size: %d.  File blocks:\n", numBytes);
+    LoadSectorMap();
+    printf("FileHeader contents.  File size: %d.  File extents:\n", numBytes);
   
-    for (i = 0; i < numSectors; i++)
-	printf("%d ", dataSectors[i]);
+    for (i = 0; i < numExtents; i++)
+	printf("%d+%d ", extentStart[i], extentLength[i]);
     printf("\nFile contents:\n");
     for (i = k = 0; i < numSectors; i++) {
-	synchDisk->ReadSector(dataSectors[i], data);
+	synchDisk->ReadSector(ByteToSector(i * SectorSize), data);
         for (j = 0; (j < SectorSize) && (k < numBytes); j++, k++) {
 	    if ('\040' <= data[j] && data[j] <= '\176')   // isprint(data[j])
 		printf("%c", data[j]);
@@ -187,49 +217,228 @@ FileHeader::Print()
         printf("\n"); 
     }
     delete [] data;
-*/
 }
 
-//return false if there's no extra sectors for addSize
+//----------------------------------------------------------------------
+// FileHeader::addFileSize
+// 	Grow the file by "addSize" bytes, allocating new data sectors (and
+//	index sectors, when the last one fills up) out of "freeMap".
+//	Return FALSE if there is not enough free space on the disk.
+//
+//	Only the index sectors whose contents change are written back;
+//	the sector map is extended in place.
+//----------------------------------------------------------------------
+
 bool 
 FileHeader::addFileSize(BitMap *freeMap, int addSize) {
-    int addSectors = divRoundUp(this->numBytes+addSize, SectorSize) - this->numSectors;
+    int newNumSectors = divRoundUp(this->numBytes+addSize, SectorSize);
+    int addSectors = newNumSectors - this->numSectors;
     if (addSectors == 0) {
         this->numBytes += addSize;
         return true;
     }
 
-
-    if (freeMap->NumClear() < (addSectors + NumDirect-1)/(NumDirect)*(NumDirect+1) ) 
+    if (freeMap->NumClear() < addSectors + IndexSectorsFor(addSectors)) 
         return false;
 
-    int indexSector = this->firstIndexSector;
-    int sector = this->numSectors;
-    int buf[NumDirect+1];
-    
-    while (sector >= NumDirect) {
-        synchDisk->ReadSector(indexSector, (char *)buf);
-        sector -= NumDirect;
-        indexSector = buf[NumDirect];
-    } 
-
-    synchDisk->ReadSector(indexSector, (char *)buf);
-    for (int i = 0; i < addSectors; i++) {
-        //sector must be less than NumDirect, so there's space for buf
-        buf[(sector+i)%NumDirect] = freeMap->Find();
-        
-        if (i == addSectors-1) {
-            synchDisk->WriteSector(indexSector, (char *)buf);
+    LoadSectorMap();
+    // the old last index sector gains entries (and maybe a next link)
+    int firstDirty = (this->numExtents == 0) ? 0 
+                        : (this->numExtents-1)/ExtentsPerIndex;
+    AddSectors(freeMap, addSectors);
+    this->numBytes += addSize;
+    for (int i = firstDirty; i < IndexSectorsFor(this->numExtents); i++)
+        WriteIndexSector(i);
+    return true;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::AddSectors
+// 	Allocate "count" data sectors at the end of the file, out of 
+//	"freeMap", which must have room for them (and for an index sector
+//	per extent, at worst).  A run that starts right where the last 
+//	extent ends just makes that extent longer.
+//----------------------------------------------------------------------
+
+void
+FileHeader::AddSectors(BitMap *freeMap, int count)
+{
+    int start, length, last;
+
+    while (count > 0) {
+        length = AllocateRun(freeMap, count, &start);
+        last = numExtents - 1;
+        if (last >= 0 && extentStart[last] + extentLength[last] == start) {
+            extentLength[last] += length;
+        } else {
+            GrowSectorMap(numExtents + 1);
+            if (numExtents > 0 && numExtents % ExtentsPerIndex == 0)
+                indexSectors[numExtents / ExtentsPerIndex] = freeMap->Find();
+            extentStart[numExtents] = start;
+            extentLength[numExtents] = length;
+            extentOffset[numExtents] = numSectors;
+            numExtents++;
+        }
+        numSectors += length;
+        count -= length;
+    }
+}
+
+//----------------------------------------------------------------------
+// FileHeader::AllocateRun
+// 	Mark up to "wanted" consecutive free sectors in "freeMap" as in
+//	use, and return how many, setting "start" to the first.
+//
+//	The sectors right after the end of the file are taken first, if
+//	they are free, so that the file stays in one piece.  Otherwise 
+//	we look for a run of "wanted" sectors, but no more than a track's
+//	worth, that lies within a single track -- the track the file ends
+//	on, or the next one that has such a run -- so that reading the
+//	run costs at most one seek, and the rest of the track comes from
+//	the disk's track buffer.  Only when no track has a run that long
+//	do we settle for shorter runs.
+//----------------------------------------------------------------------
+
+int
+FileHeader::AllocateRun(BitMap *freeMap, int wanted, int *start)
+{
+    int next, length, track, hint, i;
+
+    if (numExtents > 0) {
+        next = extentStart[numExtents - 1] + extentLength[numExtents - 1];
+        for (length = 0; length < wanted && next + length < NumSectors &&
+                !freeMap->Test(next + length); length++)
+            freeMap->Mark(next + length);
+        if (length > 0) {
+            *start = next;
+            return length;
         }
-        
-        if (i != addSectors-1 && (sector+i)%NumDirect == NumDirect-1) {
-            buf[NumDirect] = freeMap->Find();
-            synchDisk->WriteSector(indexSector, (char *)buf);
-            indexSector = buf[NumDirect];        
+        hint = next / SectorsPerTrack;
+    } else
+        hint = firstIndexSector / SectorsPerTrack;
+
+    for (length = min(wanted, SectorsPerTrack); length > 0; length /= 2)
+        for (i = 0; i < NumTracks; i++) {
+            track = (hint + i) % NumTracks;
+            *start = freeMap->FindRun(length, track * SectorsPerTrack, 
+                                (track + 1) * SectorsPerTrack);
+            if (*start != -1)
+                return length;
+        }
+    ASSERT(FALSE);			// the caller checked for room
+    return 0;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::LoadSectorMap
+// 	Read the chain of index sectors into the in-memory sector map.
+//	Done at most once for each in-memory header; after that
+//	Allocate, addFileSize and Deallocate keep the map up to date.
+//----------------------------------------------------------------------
+
+void
+FileHeader::LoadSectorMap()
+{
+    int buf[SectorSize / sizeof(int)];
+    int numIndex = IndexSectorsFor(numExtents);
+    int offset = 0, e;
+
+    if (extentStart != NULL)
+        return;				// already loaded
+
+    GrowSectorMap(numExtents);
+    indexSectors[0] = firstIndexSector;
+    for (int i = 0; i < numIndex && i * ExtentsPerIndex < numExtents; i++) {
+        synchDisk->ReadSector(indexSectors[i], (char *)buf);
+        stats->numIndexReads++;
+        for (int j = 0; j < ExtentsPerIndex && 
+                (e = i*ExtentsPerIndex + j) < numExtents; j++) {
+            extentStart[e] = buf[2*j];
+            extentLength[e] = buf[2*j + 1];
+            extentOffset[e] = offset;
+            offset += extentLength[e];
         }
+        if (i + 1 < numIndex)
+            indexSectors[i + 1] = buf[NextIndexLink];
     }
+    ASSERT(offset == numSectors);
+}
 
+//----------------------------------------------------------------------
+// FileHeader::GrowSectorMap
+// 	Make sure the sector map has room for "extents" extents (and the
+//	index sectors that describe them), keeping whatever entries are
+//	already there.
+//----------------------------------------------------------------------
 
-    this->numBytes += addSize;
-    this->numSectors = divRoundUp(this->numBytes+addSize, SectorSize) - this->numSectors;
-}
\ No newline at end of file
+void
+FileHeader::GrowSectorMap(int extents)
+{
+    if (extentStart != NULL && extents <= mapExtents)
+        return;
+
+    int newSize = max(extents, 2 * mapExtents);
+    int *newStart = new int[newSize + 1];	// +1: never a 0-length array
+    int *newLength = new int[newSize + 1];
+    int *newOffset = new int[newSize + 1];
+    int *newIndex = new int[IndexSectorsFor(newSize)];
+
+    for (int i = 0; i < mapExtents && extentStart != NULL; i++) {
+        newStart[i] = extentStart[i];
+        newLength[i] = extentLength[i];
+        newOffset[i] = extentOffset[i];
+    }
+    for (int i = 0; i < IndexSectorsFor(mapExtents) && indexSectors != NULL; i++)
+        newIndex[i] = indexSectors[i];
+    FreeSectorMap();
+    extentStart = newStart;
+    extentLength = newLength;
+    extentOffset = newOffset;
+    indexSectors = newIndex;
+    mapExtents = newSize;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::FreeSectorMap
+// 	Throw away the in-memory sector map.  It is re-read from the
+//	index chain the next time it is needed.
+//----------------------------------------------------------------------
+
+void
+FileHeader::FreeSectorMap()
+{
+    if (extentStart != NULL) {
+        delete [] extentStart;
+        delete [] extentLength;
+        delete [] extentOffset;
+        delete [] indexSectors;
+    }
+    extentStart = extentLength = extentOffset = NULL;
+    indexSectors = NULL;
+    mapExtents = 0;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::WriteIndexSector
+// 	Write index sector "which" of the chain to disk, from the sector
+//	map.  Each index sector holds ExtentsPerIndex extents, as pairs of
+//	(first sector, number of sectors), followed by the sector number
+//	of the next index sector.
+//----------------------------------------------------------------------
+
+void
+FileHeader::WriteIndexSector(int which)
+{
+    int buf[SectorSize / sizeof(int)];
+    int first = which * ExtentsPerIndex;
+
+    for (unsigned int j = 0; j < SectorSize / sizeof(int); j++)
+        buf[j] = -1;
+    for (int j = 0; j < ExtentsPerIndex && first + j < numExtents; j++) {
+        buf[2*j] = extentStart[first + j];
+        buf[2*j + 1] = extentLength[first + j];
+    }
+    buf[NextIndexLink] = (which + 1 < IndexSectorsFor(numExtents)) 
+                        ? indexSectors[which + 1] : -1;
+    synchDisk->WriteSector(indexSectors[which], (char *)buf);
+}
@@ -19,21 +19,35 @@
 
 #define NumDirect 	((SectorSize - 2 * sizeof(int)) / sizeof(int))
 #define MaxFileSize 	(NumDirect * SectorSize)
+#define ExtentsPerIndex	((int) ((SectorSize / sizeof(int) - 1) / 2))
+					// (start, length) pairs in an 
+					// index sector, before the link to
+					// the next one
 
 // The following class defines the Nachos "file header" (in UNIX terms,  
 // the "i-node"), describing where on disk to find all of the data in the file.
-// The file header is organized as a simple table of pointers to
-// data blocks. 
+// The file header is organized as a table of extents of
+// data blocks.
 //
 // The file header data structure can be stored in memory or on disk.
 // When it is on disk, it is stored in a single sector -- this means
 // that we assume the size of this data structure to be the same
-// as one disk sector.  Without indirect addressing, this
-// limits the maximum file length to just under 4K bytes.
+// as one disk sector.  The data sectors are described by a chain of
+// index sectors, starting at "firstIndexSector".  Each holds up to
+// ExtentsPerIndex extents -- runs of consecutive sectors, as (first 
+// sector, number of sectors) -- followed by the number of the next
+// index sector.  Files are allocated a track's worth of consecutive
+// sectors at a time where possible, so that most files need only a
+// few extents, and a sequential read seldom has to seek.
 //
-// There is no constructor; rather the file header can be initialized
-// by allocating blocks for the file (if it is a new file), or by
-// reading it from disk.
+// The constructor does not touch the disk; rather the file header can be
+// initialized by allocating blocks for the file (if it is a new file), or
+// by reading it from disk.
+//
+// Only the first SectorSize bytes of the object are stored on disk.  The
+// members after "forAligin" live only in memory: they cache the chain of
+// index sectors as an extent map, so that ByteToSector doesn't have
+// to go back to the disk for every lookup.
 
 /*
 class FileSectorIndex{
@@ -43,6 +57,9 @@ class FileSectorIndex{
 */
 class FileHeader {
   public:
+    FileHeader();			// Initialize with no sector map loaded
+    ~FileHeader();			// De-allocate the in-memory sector map
+
     bool Allocate(BitMap *bitMap, int fileSize);// Initialize a file header, 
 						//  including allocating space 
 						//  on disk for the file data
@@ -64,20 +81,41 @@ class FileHeader {
 
     bool addFileSize(BitMap *freeMap, int addSize);
 
-
-
+    void LoadSectorMap();		// Read the index chain into the map,
+					// if that hasn't been done yet
 
 //-----------------------members-------------------------------//
     int numBytes;			// Number of bytes in the file
     int numSectors;			// Number of data sectors in the file
     int firstIndexSector;   // the first index sector 
+    int numExtents;			// Number of extents of data sectors
    
    
     char fileType;          // the fileType
     long long createTime, lastModifyTime, lastOpenTime;
 
-    char forAligin[SectorSize-(3*4 + 3*8 + 1)];       //useless, just for aligin
-    
+    char forAligin[SectorSize-(4*4 + 3*8 + 1)];       //useless, just for aligin
+
+//-----------------in memory only, never written to disk----------------//
+  private:
+    int *extentStart;			// first disk sector of each extent,
+					// NULL until the index chain is 
+					// loaded
+    int *extentLength;			// its number of sectors
+    int *extentOffset;			// the file sector it starts at
+    int *indexSectors;			// disk sectors of the index chain
+    int mapExtents;			// # of extents the map can hold
+
+    void GrowSectorMap(int extents);	// Make room for "extents" entries
+    void FreeSectorMap();		// Forget the cached sector map
+    void WriteIndexSector(int which);	// Write index sector "which" of the
+					// chain back to disk from the map
+    void AddSectors(BitMap *freeMap, int count);	// Allocate 
+					// "count" more data sectors
+    int AllocateRun(BitMap *freeMap, int wanted, int *start);
+					// Find up to "wanted" consecutive
+					// free sectors, preferably right
+					// after the file's last one
 };
 
 #endif // FILEHDR_H
@@ -13,6 +13,11 @@
 //	   A bitmap of free disk sectors (cf. bitmap.h)
 //	   A directory of file names and file headers
 //
+//	Names are paths: "a/b/c" is looked up starting from the current 
+//	directory, "/a/b/c" from the root.  The lookups are cached in a
+//	dentry cache (cf. directory.h), so that opening the same path
+//	again reads no directory pages.
+//
 //      Both the bitmap and the directory are represented as normal
 //	files.  Their file headers are located in specific sectors
 //	(sector 0 and sector 1), so that the file system can find them 
@@ -33,8 +38,8 @@
 //	   there is no synchronization for concurrent accesses
 //	   files have a fixed size, set when the file is created
 //	   files cannot be bigger than about 3KB in size
-//	   there is no hierarchical directory structure, and only a limited
-//	     number of files can be added to the system
+//	   ".." is only understood by cdDir, where it undoes the last
+//	     change of directory
 //	   there is no attempt to make the system robust to failures
 //	    (if Nachos exits in the middle of an operation that modifies
 //	    the file system, it may corrupt the disk)
@@ -59,12 +64,9 @@
 #define FreeMapSector 		0
 #define DirectorySector 	1
 
-// Initial file sizes for the bitmap and directory; until the file system
-// supports extensible files, the directory size sets the maximum number 
-// of files that can be loaded onto the disk.
+// Initial file sizes for the bitmap and directory; directories grow 
+// as files are added to them (see directory.h for DirectoryFileSize).
 #define FreeMapFileSize 	(NumSectors / BitsInByte)
-#define NumDirEntries 		10
-#define DirectoryFileSize 	(sizeof(DirectoryEntry) * NumDirEntries)
 
 //----------------------------------------------------------------------
 // FileSystem::FileSystem
@@ -84,11 +86,11 @@ FileSystem::FileSystem(bool format)
     DEBUG('f', "Initializing the file system.\n");
     dirStackTop = 0;
     dirStackSectors[0] = DirectorySector;
+    dentries = new DentryCache(DefaultDentries);
 
 
     if (format) {
         BitMap *freeMap = new BitMap(NumSectors);
-        Directory *directory = new Directory(NumDirEntries);
 	FileHeader *mapHdr = new FileHeader;
 	FileHeader *dirHdr = new FileHeader;
 
@@ -129,18 +131,20 @@ FileSystem::FileSystem(bool format)
 
         DEBUG('f', "Writing bitmap and directory back to disk.\n");
 	freeMap->WriteBack(freeMapFile);	 // flush changes to disk
-	directory->WriteBack(directoryFile);
+	Directory::Format(directoryFile);
         DEBUG('f', "Writing bitmap and directory back to disk.\n");
 
 
     	if (DebugIsEnabled('f')) {
+	    Directory *directory = new Directory(directoryFile);
+
     	    freeMap->Print();
     	    directory->Print();
-            delete freeMap; 
     	   delete directory; 
-    	   delete mapHdr; 
-    	   delete dirHdr;
     	}
+        delete freeMap; 
+        delete mapHdr; 
+        delete dirHdr;
 
     } else {
     // if we are not formatting the disk, just open the files representing
@@ -160,9 +164,9 @@ FileSystem::FileSystem(bool format)
 //	  Make sure the file doesn't already exist
 //        Allocate a sector for the file header
 // 	  Allocate space on disk for the data blocks for the file
-//	  Add the name to the directory
+//	  Add the name to the directory, which writes it to disk
 //	  Store the new file header on disk 
-//	  Flush the changes to the bitmap and the directory back to disk
+//	  Flush the changes to the bitmap back to disk
 //
 //	Return TRUE if everything goes ok, otherwise, return FALSE.
 //
@@ -175,27 +179,32 @@ FileSystem::FileSystem(bool format)
 // 	Note that this implementation assumes there is no concurrent access
 //	to the file system!
 //
-//	"name" -- name of file to be created
+//	"path" -- name of file to be created
 //	"initialSize" -- size of file to be created
 //----------------------------------------------------------------------
 
 bool
-FileSystem::Create(char *name, int initialSize)
+FileSystem::Create(char *path, int initialSize)
 {
     Directory *directory;
+    OpenFile *dirFile;
     BitMap *freeMap;
     FileHeader *hdr;
-    int sector;
+    char name[FileNameMaxLen + 1], type;
+    int sector, parent;
     bool success;
 
-    DEBUG('f', "Creating file %s, size %d\n", name, initialSize);
+    DEBUG('f', "Creating file %s, size %d\n", path, initialSize);
 
-    directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
+    parent = FindParent(path, name);
+    if (parent == -1)
+	return FALSE;			// no such directory
+    if (LookupName(parent, name, &type) != -1)
+	return FALSE;			// file is already in directory
+    dirFile = OpenDirectory(parent);
+    directory = new Directory(dirFile);
 
-    if (directory->Find(name) != -1)
-      success = FALSE;			// file is already in directory
-    else {	
+    {	
 
         freeMap = new BitMap(NumSectors);
         freeMap->FetchFrom(freeMapFile);
@@ -203,8 +212,6 @@ FileSystem::Create(char *name, int initialSize)
         sector = freeMap->Find();	// find a sector to hold the file header
     	if (sector == -1) 		
             success = FALSE;		// no free block for file header 
-        else if (!directory->Add(name, sector, 'f'))
-            success = FALSE;	// no space in directory
 	else {
     	    hdr = new FileHeader;
 
@@ -212,12 +219,18 @@ FileSystem::Create(char *name, int initialSize)
 
 	    if (!hdr->Allocate(freeMap, initialSize))
             	success = FALSE;	// no space on disk for data
-	    else {	
+	    else if (!directory->Add(name, sector, 'f', freeMap)) {
+            	success = FALSE;	// no space in directory
+		hdr->Deallocate(freeMap);
+		freeMap->Clear(sector);
+		freeMap->WriteBack(freeMapFile);   // the directory may 
+						   // have grown anyway
+	    } else {	
 	    	success = TRUE;
 		// everthing worked, flush all changes back to disk
     	    	hdr->WriteBack(sector); 		
-    	    	directory->WriteBack(directoryFile);
     	    	freeMap->WriteBack(freeMapFile);
+		dentries->Enter(parent, name, sector, 'f');
 	            
         }
             delete hdr;
@@ -225,6 +238,7 @@ FileSystem::Create(char *name, int initialSize)
         delete freeMap;
     }
     delete directory;
+    CloseDirectory(dirFile);
     return success;
 }
 
@@ -232,64 +246,67 @@ FileSystem::Create(char *name, int initialSize)
 // FileSystem::Open
 // 	Open a file for reading and writing.  
 //	To open a file:
-//	  Find the location of the file's header, using the directory 
+//	  Find the location of the file's header, using the directories
+//	    on its path (or the dentry cache)
 //	  Bring the header into memory
 //
-//	"name" -- the text name of the file to be opened
+//	"path" -- the text name of the file to be opened
 //----------------------------------------------------------------------
 
 OpenFile *
-FileSystem::Open(char *name)
+FileSystem::Open(char *path)
 { 
-    Directory *directory = new Directory(NumDirEntries);
     OpenFile *openFile = NULL;
-    int sector;
+    char name[FileNameMaxLen + 1], type;
+    int sector = -1, parent;
 
-    DEBUG('f', "Opening file %s\n", name);
-    directory->FetchFrom(directoryFile);
-    sector = directory->Find(name); 
+    DEBUG('f', "Opening file %s\n", path);
+    parent = FindParent(path, name);
+    if (parent != -1)
+	sector = LookupName(parent, name, &type);
     if (sector >= 0) 		
 	openFile = new OpenFile(sector);	// name was found in directory 
-    delete directory;
     return openFile;				// return NULL if not found
 }
 
 //----------------------------------------------------------------------
 // FileSystem::Remove
 // 	Delete a file from the file system.  This requires:
-//	    Remove it from the directory
+//	    Remove it from the directory, which writes it to disk
 //	    Delete the space for its header
 //	    Delete the space for its data blocks
-//	    Write changes to directory, bitmap back to disk
+//	    Write changes to the bitmap back to disk
 //
 //	Return TRUE if the file was deleted, FALSE if the file wasn't
 //	in the file system.
 //
-//	"name" -- the text name of the file to be removed
+//	"path" -- the text name of the file to be removed
 //----------------------------------------------------------------------
 
 bool
-FileSystem::Remove(char *name)
+FileSystem::Remove(char *path)
 { 
     Directory *directory;
+    OpenFile *dirFile;
     BitMap *freeMap;
     FileHeader *fileHdr;
-    int sector;
+    char name[FileNameMaxLen + 1], type;
+    int sector, parent;
     
-    directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
-    sector = directory->Find(name);
-    if (sector == -1) {
-       delete directory;
+    parent = FindParent(path, name);
+    if (parent == -1)
+	return FALSE;			 // no such directory
+    sector = LookupName(parent, name, &type);
+    if (sector == -1)
        return FALSE;			 // file not found 
-    }
 
     if (synchFiles->GetOpenNum(sector) != 1) {
         printf("remove failed unsuccessfully, because more than one threads are opening the file\n");
-       delete directory;
        return FALSE;             // file is opened in more than one thread 
     }
     
+    dirFile = OpenDirectory(parent);
+    directory = new Directory(dirFile);
 
     fileHdr = new FileHeader;
     fileHdr->FetchFrom(sector);
@@ -300,14 +317,17 @@ FileSystem::Remove(char *name)
     fileHdr->Deallocate(freeMap);  		// remove data blocks
     freeMap->Clear(sector);			// remove header block
     directory->Remove(name);
+    dentries->Enter(parent, name, -1, 0);	// now known not to be there
+    if (type == 'd')
+	dentries->Purge(sector);		// its sector may be reused
 
     freeMap->WriteBack(freeMapFile);		// flush to disk
-    directory->WriteBack(directoryFile);        // flush to disk
     delete fileHdr;
     delete directory;
+    CloseDirectory(dirFile);
     delete freeMap;
 
-    printf("remove file %s successfully\n", name);
+    printf("remove file %s successfully\n", path);
     return TRUE;
 } 
 
@@ -319,9 +339,8 @@ FileSystem::Remove(char *name)
 void
 FileSystem::List()
 {
-    Directory *directory = new Directory(NumDirEntries);
+    Directory *directory = new Directory(directoryFile);
 
-    directory->FetchFrom(directoryFile);
     directory->List();
     delete directory;
 }
@@ -342,7 +361,7 @@ FileSystem::Print()
     FileHeader *bitHdr = new FileHeader;
     FileHeader *dirHdr = new FileHeader;
     BitMap *freeMap = new BitMap(NumSectors);
-    Directory *directory = new Directory(NumDirEntries);
+    Directory *directory = new Directory(directoryFile);
 
     printf("Bit map file header:\n");
     bitHdr->FetchFrom(FreeMapSector);
@@ -355,7 +374,6 @@ FileSystem::Print()
     freeMap->FetchFrom(freeMapFile);
     freeMap->Print();
 
-    directory->FetchFrom(directoryFile);
     directory->Print();
 
     delete bitHdr;
@@ -371,28 +389,36 @@ FileSystem::addFileSize(OpenFile *file, int size)
     freeMap->FetchFrom(this->freeMapFile);
     
     bool result = file->hdr->addFileSize(freeMap, size);
+    if (result)
+        freeMap->WriteBack(this->freeMapFile);	// flush new sectors to disk
     file->updateHeader();
+    delete freeMap;
     return result;
 }
 
 bool
-FileSystem::makeDir(char* name)
+FileSystem::makeDir(char* path)
 {
 
     Directory *directory;
+    OpenFile *dirFile;
     BitMap *freeMap;
     FileHeader *hdr;
-    int sector;
+    char name[FileNameMaxLen + 1], type;
+    int sector, parent;
     bool success;
 
-    DEBUG('f', "making directory %s\n", name);
+    DEBUG('f', "making directory %s\n", path);
 
-    directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
+    parent = FindParent(path, name);
+    if (parent == -1)
+        return FALSE;           // no such directory
+    if (LookupName(parent, name, &type) != -1)
+        return FALSE;           // file is already in directory
+    dirFile = OpenDirectory(parent);
+    directory = new Directory(dirFile);
 
-    if (directory->Find(name) != -1)
-      success = FALSE;          // file is already in directory
-    else {  
+    {  
 
         freeMap = new BitMap(NumSectors);
         freeMap->FetchFrom(freeMapFile);
@@ -400,8 +426,6 @@ FileSystem::makeDir(char* name)
         sector = freeMap->Find();   // find a sector to hold the file header
         if (sector == -1)       
             success = FALSE;        // no free block for file header 
-        else if (!directory->Add(name, sector, 'd'))
-            success = FALSE;    // no space in directory
         else {
             hdr = new FileHeader;
 
@@ -409,46 +433,159 @@ FileSystem::makeDir(char* name)
 
             if (!hdr->Allocate(freeMap, DirectoryFileSize))
                 success = FALSE;    // no space on disk for data
-            else {  
+            else if (!directory->Add(name, sector, 'd', freeMap)) {
+                success = FALSE;    // no space in directory
+                hdr->Deallocate(freeMap);
+                freeMap->Clear(sector);
+                freeMap->WriteBack(freeMapFile);  // the directory may 
+                                                  // have grown anyway
+            } else {  
                 success = TRUE;
                 // everthing worked, flush all changes back to disk
                 hdr->WriteBack(sector);         
-                directory->WriteBack(directoryFile);
                 freeMap->WriteBack(freeMapFile);  
 
-                Directory *newDirectory = new Directory(NumDirEntries);
                 OpenFile *newDirectoryFile = new OpenFile(sector);
-                newDirectory->WriteBack(newDirectoryFile);
-                delete newDirectory;
+                Directory::Format(newDirectoryFile);
                 delete newDirectoryFile;         
+                dentries->Enter(parent, name, sector, 'd');
+                dentries->Purge(sector);    // nothing is in it yet
             }
             delete hdr;
         }
         delete freeMap;
     }
     delete directory;
+    CloseDirectory(dirFile);
     return success;
     
 }
 
+//----------------------------------------------------------------------
+// FileSystem::cdDir
+// 	Change the current directory to "path", which must name a 
+//	directory, or back to the one before the last change, if "path"
+//	is "..".  Return FALSE if there is no such directory.
+//----------------------------------------------------------------------
+
 bool 
-FileSystem::cdDir(char *name) 
+FileSystem::cdDir(char *path) 
 {
-    Directory *directory = new Directory(NumDirEntries);
-    directory->FetchFrom(directoryFile);
-    
-    int sector = directory->FindDirectory(name);
-    if (strlen(name) == 2 && !strcmp(name, "..")) {
+    char name[FileNameMaxLen + 1], type;
+    int sector = -1, parent;
+    OpenFile *oldFile = directoryFile;
+
+    if (!strcmp(path, "..")) {
         dirStackTop = max(0, dirStackTop-1);
         sector = dirStackSectors[dirStackTop];
+    } else if (!strcmp(path, "/")) {
+        dirStackTop = 0;
+        sector = DirectorySector;
+    } else if ((parent = FindParent(path, name)) != -1) {
+        sector = LookupName(parent, name, &type);
+        if (sector != -1 && type != 'd')
+            sector = -1;
     }
     printf("now sector %d\n", sector);
-    if (sector == -1) return false;
-    else {
+    if (sector == -1 || (sector != dirStackSectors[dirStackTop] && 
+            dirStackTop == MAX_DIR_DEEP - 1)) 
+        return false;
+    if (sector != dirStackSectors[dirStackTop]) {
+        if (path[0] == '/')
+            dirStackTop = 0;
         dirStackSectors[++dirStackTop] = sector;
-    }   
+    }
 
     directoryFile = new OpenFile(sector);
-    delete directory;
+    delete oldFile;
     return true;
-}
\ No newline at end of file
+}
+
+//----------------------------------------------------------------------
+// FileSystem::FindParent
+// 	Find the directory holding the last name on "path", by looking up
+//	each of the names before it in turn.  Copy the last name into
+//	"name", and return the sector of the directory's file header, or
+//	-1 if some directory on the path doesn't exist, or a name on it 
+//	is empty or too long.
+//
+//	"path" -- names separated by '/', starting from the root if the
+//		path starts with '/', else from the current directory
+//	"name" -- FileNameMaxLen + 1 bytes, for the last name
+//----------------------------------------------------------------------
+
+int
+FileSystem::FindParent(char *path, char *name)
+{
+    int sector = (path[0] == '/') ? DirectorySector 
+				  : dirStackSectors[dirStackTop];
+    int length;
+    char type;
+
+    for (;;) {
+	while (*path == '/')
+	    path++;
+	length = strcspn(path, "/");
+	if (length == 0 || length > FileNameMaxLen)
+	    return -1;
+	strncpy(name, path, length);
+	name[length] = '\0';
+	for (path += length; *path == '/'; path++)
+	    ;
+	if (*path == '\0')
+	    return sector;		// "name" is the last one
+	sector = LookupName(sector, name, &type);
+	if (sector == -1 || type != 'd')
+	    return -1;
+    }
+}
+
+//----------------------------------------------------------------------
+// FileSystem::LookupName
+// 	Return the sector of the file header for "name", in the directory
+//	whose header is in "dirSector", setting "type" to 'f' or 'd'; or 
+//	return -1 if the name isn't there.  The answer comes from the 
+//	dentry cache if it can, and goes into it if not.
+//----------------------------------------------------------------------
+
+int
+FileSystem::LookupName(int dirSector, char *name, char *type)
+{
+    OpenFile *dirFile;
+    Directory *directory;
+    int sector;
+
+    if (dentries->Lookup(dirSector, name, &sector, type))
+	return sector;
+
+    dirFile = OpenDirectory(dirSector);
+    directory = new Directory(dirFile);
+    *type = 0;
+    sector = directory->Find(name, type);
+    dentries->Enter(dirSector, name, sector, *type);
+    delete directory;
+    CloseDirectory(dirFile);
+    return sector;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::OpenDirectory, CloseDirectory
+// 	Get an open file for the directory whose header is in "sector",
+//	and give it back.  The current directory is always open; other
+//	directories are opened for the occasion.
+//----------------------------------------------------------------------
+
+OpenFile *
+FileSystem::OpenDirectory(int sector)
+{
+    if (sector == dirStackSectors[dirStackTop])
+	return directoryFile;
+    return new OpenFile(sector);
+}
+
+void
+FileSystem::CloseDirectory(OpenFile *file)
+{
+    if (file != directoryFile)
+	delete file;
+}
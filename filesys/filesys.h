@@ -113,10 +113,17 @@ class FileSystem {
   private:
    OpenFile* freeMapFile;		// Bit map of free disk blocks,
 					// represented as a file
-   OpenFile* directoryFile;		// "Root" directory -- list of 
+   OpenFile* directoryFile;		// Current directory -- list of 
 					// file names, represented as a file
-
-   
+   DentryCache *dentries;		// Recent lookups of names in
+					// directories
+
+   int FindParent(char *path, char *name);  // Find the directory that
+					// holds the last name of "path"
+   int LookupName(int dirSector, char *name, char *type);
+					// Find "name" in a directory
+   OpenFile *OpenDirectory(int sector);	// Open a directory file, or use
+   void CloseDirectory(OpenFile *file);	// the current one if it is that
 };
 
 #endif // FILESYS
@@ -7,6 +7,18 @@
 //	   Perftest -- a stress test for the Nachos file system
 //		read and write a really large file in tiny chunks
 //		(won't work on baseline system!)
+//	   DiskQueueTest -- many threads reading random sectors at once,
+//		to compare disk scheduling policies
+//	   BitMapBenchmark -- time allocating and freeing every sector
+//		in a free-sector map
+//	   DirectoryBenchmark -- time creating and looking up files
+//		as a directory grows
+//	   PathTest -- open a file by a deep path, through the dentry
+//		cache
+//	   ReadBenchmark -- many threads reading one file at once
+//
+//	Run the tests that time disk reads with "-bc 0", so that the buffer
+//	cache doesn't hide the disk.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -20,6 +32,8 @@
 #include "thread.h"
 #include "disk.h"
 #include "stats.h"
+#include "bitmap.h"
+#include <time.h>
 
 #define TransferSize 	10 	// make it small, just to be difficult
 
@@ -184,6 +198,36 @@ FileRead()
     delete openFile;	// close file
 }
 
+//----------------------------------------------------------------------
+// FileThroughput
+// 	Read the file back a sector at a time, and report the average 
+//	simulated time per sector.  When the file lies in consecutive 
+//	sectors of a track, the disk's track buffer makes most reads cost
+//	about RotationTime; every seek adds SeekTime per track crossed.
+//----------------------------------------------------------------------
+
+static void
+FileThroughput()
+{
+    OpenFile *openFile;
+    char buffer[SectorSize];
+    int sectors = 0, startTicks, startReads;
+
+    if ((openFile = fileSystem->Open(FileName)) == NULL) {
+	printf("Perf test: unable to open file %s\n", FileName);
+	return;
+    }
+    startTicks = stats->totalTicks;
+    startReads = stats->numDiskReads;
+    while (openFile->Read(buffer, SectorSize) > 0)
+	sectors++;
+    printf("Sequential read of %d sectors: %d ticks per sector, "
+	"%d disk reads (track buffer rate %d)\n", sectors,
+	(stats->totalTicks - startTicks) / max(sectors, 1),
+	stats->numDiskReads - startReads, RotationTime);
+    delete openFile;
+}
+
 
 void mkdir() {
     fileSystem->makeDir("inpku");
@@ -222,6 +266,7 @@ PerformanceTest()
 	printf("Starting file system performance test:\n");
     stats->Print();
     FileWrite();
+    FileThroughput();
     testMultiOpen();
 
 /*   FileRead();
@@ -238,3 +283,255 @@ PerformanceTest()
     //test more multiple threads open file and remove
     
 }
+
+//----------------------------------------------------------------------
+// DiskQueueTest
+// 	Fork a number of threads that each read random sectors straight
+//	from synchDisk, so that many requests are outstanding at once.
+//	Compare the latencies printed for each "-ds" policy.
+//----------------------------------------------------------------------
+
+#define QueueTestThreads	16	// concurrent readers
+#define QueueTestReads		64	// sectors read by each of them
+
+static Semaphore *queueTestDone;
+
+static void
+DiskQueueReader(int which)
+{
+    char buffer[SectorSize];
+
+    for (int i = 0; i < QueueTestReads; i++)
+	synchDisk->ReadSector(Random() % NumSectors, buffer);
+    queueTestDone->V();
+}
+
+void
+DiskQueueTest()
+{
+    int i, start = stats->totalTicks;
+
+    printf("Disk queue test: %d threads, %d random reads each\n",
+	QueueTestThreads, QueueTestReads);
+    queueTestDone = new Semaphore("disk queue test", 0);
+    for (i = 0; i < QueueTestThreads; i++) {
+	Thread *t = new Thread("disk reader");
+	t->Fork(DiskQueueReader, i);
+    }
+    for (i = 0; i < QueueTestThreads; i++)
+	queueTestDone->P();
+    delete queueTestDone;
+
+    printf("Disk queue test: done in %d ticks\n", stats->totalTicks - start);
+    stats->Print();
+}
+
+//----------------------------------------------------------------------
+// BitMapBenchmark
+// 	Time the operations on a free-sector map (in host CPU time; 
+//	they take no simulated time): allocating every sector one at a
+//	time with Find and freeing them all again, the same with runs of
+//	BenchmarkRun sectors from FindRun, and counting the free sectors.
+//	No disk is involved.
+//----------------------------------------------------------------------
+
+#define BenchmarkRounds	1000	// times the whole map is allocated
+#define BenchmarkRun	8	// sectors per FindRun
+
+static double
+MicrosecondsPer(clock_t start, int operations)
+{
+    return (clock() - start) * 1000000.0 / CLOCKS_PER_SEC / operations;
+}
+
+void
+BitMapBenchmark()
+{
+    BitMap *map = new BitMap(NumSectors);
+    int i, round, found = 0, count = 0;
+    clock_t start;
+
+    printf("BitMap benchmark: %d sectors, %d rounds\n", NumSectors, 
+	BenchmarkRounds);
+
+    start = clock();
+    for (round = 0; round < BenchmarkRounds; round++) {
+	for (i = 0; i <= NumSectors; i++)	// the last one fails
+	    found += (map->Find() != -1);
+	for (i = 0; i < NumSectors; i++)
+	    map->Clear(i);
+    }
+    printf("Find + Clear: %.3f us per sector\n", 
+	MicrosecondsPer(start, BenchmarkRounds * NumSectors));
+
+    start = clock();
+    for (round = 0; round < BenchmarkRounds; round++) {
+	for (i = 0; i + BenchmarkRun <= NumSectors; i += BenchmarkRun)
+	    found += (map->FindRun(BenchmarkRun) != -1);
+	map->ClearRun(0, NumSectors);
+    }
+    printf("FindRun(%d) + ClearRun: %.3f us per run\n", BenchmarkRun,
+	MicrosecondsPer(start, BenchmarkRounds * (NumSectors / BenchmarkRun)));
+
+    start = clock();
+    for (round = 0; round < BenchmarkRounds; round++)
+	count += map->NumClear();
+    printf("NumClear: %.3f us per call\n", 
+	MicrosecondsPer(start, BenchmarkRounds));
+    ASSERT(found == BenchmarkRounds * (NumSectors + NumSectors / BenchmarkRun));
+    ASSERT(count == BenchmarkRounds * NumSectors);
+    delete map;
+}
+
+//----------------------------------------------------------------------
+// DirectoryBenchmark
+// 	Fill the current directory with empty files, and after each step
+//	report the simulated time to create a file, and to look one up
+//	(by opening it), averaged over the step.  With a hashed directory
+//	both stay flat as the directory grows.  The simulated disk only
+//	has room for a few hundred files, so run it on a freshly 
+//	formatted disk.
+//----------------------------------------------------------------------
+
+#define DirBenchmarkFiles	400	// files in the directory at the end
+
+void
+DirectoryBenchmark()
+{
+    char name[FileNameMaxLen + 1];
+    int created = 0, step, i, start, startReads, opened;
+    OpenFile *openFile;
+
+    printf("Directory benchmark: up to %d files\n", DirBenchmarkFiles);
+    for (step = DirBenchmarkFiles / 8; step <= DirBenchmarkFiles; step *= 2) {
+	start = stats->totalTicks;
+	for (i = created; i < step; i++) {
+	    sprintf(name, "bench%d", i);
+	    if (!fileSystem->Create(name, 0)) {
+		printf("Directory benchmark: can't create %s\n", name);
+		return;
+	    }
+	}
+	printf("%d files: create %d ticks per file", step, 
+	    (stats->totalTicks - start) / (step - created));
+	created = step;
+
+	start = stats->totalTicks;
+	startReads = stats->numDiskReads;
+	for (i = opened = 0; i < created; i++) {
+	    sprintf(name, "bench%d", i);
+	    if ((openFile = fileSystem->Open(name)) != NULL) {
+		opened++;
+		delete openFile;
+	    }
+	}
+	ASSERT(opened == created);
+	printf(", open %d ticks and %d disk reads per file\n", 
+	    (stats->totalTicks - start) / created, 
+	    (stats->numDiskReads - startReads) / created);
+    }
+}
+
+//----------------------------------------------------------------------
+// PathTest
+// 	Make a few nested directories, create a file at the bottom, and
+//	open it by its full path over and over.  Once the first open has
+//	filled the dentry cache, the others should read no directory 
+//	pages.  Then remove the file, and check that opening it fails,
+//	from a negative dentry.
+//----------------------------------------------------------------------
+
+#define PathTestOpens	100	// opens of the deep path
+
+void
+PathTest()
+{
+    OpenFile *openFile;
+    int i, pageReads, misses;
+
+    if (!fileSystem->makeDir("/pt1") || !fileSystem->makeDir("/pt1/pt2")
+	    || !fileSystem->makeDir("/pt1/pt2/pt3")
+	    || !fileSystem->Create("/pt1/pt2/pt3/file", 0)) {
+	printf("Path test: can't make /pt1/pt2/pt3/file\n");
+	return;
+    }
+
+    pageReads = stats->numDirPageReads;
+    misses = stats->numDentryMisses;
+    for (i = 0; i < PathTestOpens; i++) {
+	openFile = fileSystem->Open("/pt1/pt2/pt3/file");
+	ASSERT(openFile != NULL);
+	delete openFile;
+    }
+    printf("Path test: %d opens, %d directory page reads, %d dentry misses\n",
+	PathTestOpens, stats->numDirPageReads - pageReads, 
+	stats->numDentryMisses - misses);
+
+    openFile = fileSystem->Open("/pt1/pt2/pt3/file");	// Remove wants
+    fileSystem->Remove("/pt1/pt2/pt3/file");		// it open once
+    delete openFile;
+    pageReads = stats->numDirPageReads;
+    openFile = fileSystem->Open("/pt1/pt2/pt3/file");
+    ASSERT(openFile == NULL);
+    printf("Path test: open after remove failed, %d directory page reads\n",
+	stats->numDirPageReads - pageReads);
+}
+
+//----------------------------------------------------------------------
+// ReadBenchmark
+// 	Time ReadBenchThreads threads, each with its own OpenFile, reading
+//	the same file at once, against one thread reading it as many 
+//	times.  The concurrent readers share the file's lock, so their
+//	disk requests overlap, and the disk scheduler can order them.
+//	Each starts at a different place in the file, and wraps around.
+//----------------------------------------------------------------------
+
+#define ReadBenchFile		"readbench"
+#define ReadBenchSectors	64	// size of the file
+#define ReadBenchThreads	4	// concurrent readers
+
+static Semaphore *readBenchDone;
+
+static void
+ReadBenchReader(int which)
+{
+    OpenFile *openFile = fileSystem->Open(ReadBenchFile);
+    char buffer[SectorSize];
+    int first = which * ReadBenchSectors / ReadBenchThreads;
+
+    ASSERT(openFile != NULL);
+    for (int i = 0; i < ReadBenchSectors; i++)
+	openFile->ReadAt(buffer, SectorSize, 
+	    ((first + i) % ReadBenchSectors) * SectorSize);
+    delete openFile;
+    readBenchDone->V();
+}
+
+void
+ReadBenchmark()
+{
+    int i, start, serial;
+
+    fileSystem->Create(ReadBenchFile, ReadBenchSectors * SectorSize);
+    printf("Read benchmark: %d threads reading a %d sector file\n", 
+	ReadBenchThreads, ReadBenchSectors);
+    readBenchDone = new Semaphore("read benchmark", 0);
+
+    start = stats->totalTicks;
+    for (i = 0; i < ReadBenchThreads; i++) {	// one after the other
+	ReadBenchReader(i);
+	readBenchDone->P();
+    }
+    serial = stats->totalTicks - start;
+
+    start = stats->totalTicks;
+    for (i = 0; i < ReadBenchThreads; i++) {	// all at once
+	Thread *t = new Thread("file reader");
+	t->Fork(ReadBenchReader, i);
+    }
+    for (i = 0; i < ReadBenchThreads; i++)
+	readBenchDone->P();
+    printf("Read benchmark: %d ticks one at a time, %d ticks together\n",
+	serial, stats->totalTicks - start);
+    delete readBenchDone;
+}
@@ -5,7 +5,8 @@
 //	the OpenFile data structure).
 //
 //	Also as in UNIX, for convenience, we keep the file header in
-//	memory while the file is open.
+//	memory while the file is open, one copy however many times it
+//	is open.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -21,23 +22,29 @@
 
 //----------------------------------------------------------------------
 // OpenFile::OpenFile
-// 	Open a Nachos file for reading and writing.  Bring the file header
-//	into memory while the file is open.
+// 	Open a Nachos file for reading and writing.  The file header is
+//	brought into memory by the first open of the file, and shared
+//	(with the file's lock) by all of its OpenFiles until the last one
+//	is closed.
 //
 //	"sector" -- the location on disk of the file header for this file
 //----------------------------------------------------------------------
 
 OpenFile::OpenFile(int sector)
 { 
+    FileStatus *status = synchFiles->OpenFile(sector);
+
     headSector = sector;
-    hdr = new FileHeader;
-    hdr->FetchFrom(sector);
+    hdr = status->hdr;
+    lock = status->lock;
     seekPosition = 0;
+    readAheadLock = new Lock("read ahead lock");
+    readAheadNext = 0;
+    readAheadWindow = 0;
+    readAheadEnd = -1;
 
-    hdr->lastOpenTime = clock();
-    this->updateHeader();                   // update hdr, using hdr->writeBack(headSector)
-
-    synchFiles->OpenFile(this->headSector);
+    hdr->lastOpenTime = clock();	// reaches the disk with the next
+					// change to the header
 }
 
 //----------------------------------------------------------------------
@@ -47,8 +54,9 @@ OpenFile::OpenFile(int sector)
 
 OpenFile::~OpenFile()
 {
-    synchFiles->CloseFile(this->headSector);
-    delete hdr;
+    synchFiles->CloseFile(this->headSector);	// frees the header, if
+						// this was the last open
+    delete readAheadLock;
 }
 
 //----------------------------------------------------------------------
@@ -106,8 +114,13 @@ OpenFile::Write(char *into, int numBytes)
 //
 //	For ReadAt:
 //	   We read in all of the full or partial sectors that are part of the
-//	   request, but we only copy the part we are interested in.
+//	   request, but we only copy the part we are interested in.  If the
+//	   file is being read sequentially, the sectors after the request
+//	   are queued for read-ahead first.
 //	For WriteAt:
+//	   A write that runs past the end of the file first grows the
+//	   file (with FileSystem::addFileSize) to take it; if the disk is
+//	   full, only the part that fits is written.
 //	   We must first read in any sectors that will be partially written,
 //	   so that we don't overwrite the unmodified portion.  We then copy
 //	   in the data that will be modified, and write back all the full
@@ -123,8 +136,7 @@ OpenFile::Write(char *into, int numBytes)
 int
 OpenFile::ReadAt(char *into, int numBytes, int position)
 {
-    Lock *lock = synchFiles->GetLock(this->headSector);
-    lock->Acquire();
+    lock->AcquireRead();
 
     int fileLength = hdr->FileLength();
     int i, firstSector, lastSector, numSectors;
@@ -132,8 +144,10 @@ OpenFile::ReadAt(char *into, int numBytes, int position)
 
    // printf("%d\n", fileLength);
 
-    if ((numBytes <= 0) || (position >= fileLength))
+    if ((numBytes <= 0) || (position >= fileLength)) {
+	lock->ReleaseRead();
     	return 0; 				// check request
+    }
     if ((position + numBytes) > fileLength)		
 	numBytes = fileLength - position;
     DEBUG('f', "Reading %d bytes at %d, from file of length %d.\n", 	
@@ -143,6 +157,8 @@ OpenFile::ReadAt(char *into, int numBytes, int position)
     lastSector = divRoundDown(position + numBytes - 1, SectorSize);
     numSectors = 1 + lastSector - firstSector;
 
+    ReadAhead(position, numBytes, lastSector);
+
     // read in all the full and partial sectors that we need
     buf = new char[numSectors * SectorSize];
     for (i = firstSector; i <= lastSector; i++)	
@@ -153,7 +169,7 @@ OpenFile::ReadAt(char *into, int numBytes, int position)
     bcopy(&buf[position - (firstSector * SectorSize)], into, numBytes);
     delete [] buf;
 
-    lock->Release();
+    lock->ReleaseRead();
     return numBytes;
 }
 
@@ -193,8 +209,7 @@ OpenFile::WritingRead(char *into, int numBytes, int position)
 int
 OpenFile::WriteAt(char *from, int numBytes, int position)
 {
-    Lock *lock = synchFiles->GetLock(this->headSector);
-    lock->Acquire();
+    lock->AcquireWrite();
 
 
     int fileLength = hdr->FileLength();
@@ -202,8 +217,14 @@ OpenFile::WriteAt(char *from, int numBytes, int position)
     bool firstAligned, lastAligned;
     char *buf;
 
-    if ((numBytes <= 0) || (position >= fileLength))
+    if ((numBytes > 0) && ((position + numBytes) > fileLength)) {
+	fileSystem->addFileSize(this, position + numBytes - fileLength);
+	fileLength = hdr->FileLength();		// unchanged if the disk is full
+    }
+    if ((numBytes <= 0) || (position >= fileLength)) {
+	lock->ReleaseWrite();
 	return 0;				// check request
+    }
     if ((position + numBytes) > fileLength)
 	numBytes = fileLength - position;
     DEBUG('f', "Writing %d bytes at %d, from file of length %d.\n", 	
@@ -239,10 +260,57 @@ OpenFile::WriteAt(char *from, int numBytes, int position)
 
    DEBUG('f', "finish writeing \n");
     
-    lock->Release();
+    lock->ReleaseWrite();
     return numBytes;
 }
 
+//----------------------------------------------------------------------
+// OpenFile::ReadAhead
+// 	Called by ReadAt for each read.  A read that starts where the
+//	previous one ended is sequential; while reads stay sequential we
+//	keep up to "readAheadWindow" sectors beyond the current one queued
+//	for the read-ahead thread, doubling the window (up to MaxReadAhead)
+//	each time it is refilled.  Any other read resets the window.
+//
+//	The window is only refilled once less than half of it is left, so
+//	that small reads within one sector don't queue a request each.
+//
+//	The state belongs to this OpenFile, but ReadAt only holds the
+//	file's lock shared, so that threads reading through the same
+//	OpenFile need readAheadLock to update it.
+//
+//	"position" -- where the read starts
+//	"numBytes" -- how many bytes are read
+//	"lastSector" -- the last file sector the read touches
+//----------------------------------------------------------------------
+
+void
+OpenFile::ReadAhead(int position, int numBytes, int lastSector)
+{
+    int fileSectors = divRoundUp(hdr->FileLength(), SectorSize);
+    int i, start, end;
+
+    readAheadLock->Acquire();
+    if (position != readAheadNext) {		// random access
+	readAheadWindow = 0;
+	readAheadEnd = lastSector;
+    } else {
+	if (readAheadWindow == 0)
+	    readAheadWindow = MinReadAhead;
+	if (readAheadEnd - lastSector < readAheadWindow / 2) {
+	    start = max(readAheadEnd, lastSector) + 1;
+	    end = min(lastSector + readAheadWindow, fileSectors - 1);
+	    for (i = start; i <= end; i++)
+		synchDisk->ReadAhead(hdr->ByteToSector(i * SectorSize));
+	    if (end > readAheadEnd)
+		readAheadEnd = end;
+	    readAheadWindow = min(2 * readAheadWindow, MaxReadAhead);
+	}
+    }
+    readAheadNext = position + numBytes;
+    readAheadLock->Release();
+}
+
 //----------------------------------------------------------------------
 // OpenFile::Length
 // 	Return the number of bytes in the file.
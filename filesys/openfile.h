@@ -28,7 +28,8 @@
 					// See definitions listed under #else
 class OpenFile {
   public:
-    OpenFile(int f) { file = f; currentOffset = 0; }	// open the file
+    OpenFile(int f) { file = f; currentOffset = 0; headSector = FileId(f); }
+							// open the file
     ~OpenFile() { Close(file); }			// close the file
 
     int ReadAt(char *into, int numBytes, int position) { 
@@ -52,6 +53,10 @@ class OpenFile {
 		}
 
     int Length() { Lseek(file, 0, 2); return Tell(file); }
+
+    int headSector;			// UNIX has no file headers; the
+					// inode number tells files apart
+					// just as well
     
   private:
     int file;
@@ -60,6 +65,12 @@ class OpenFile {
 
 #else // FILESYS
 class FileHeader;
+class Lock;
+class RWLock;
+
+#define MinReadAhead	2	// read-ahead window, in sectors, when a
+				// sequential run is first noticed
+#define MaxReadAhead	16	// the window doubles up to this size
 
 class OpenFile {
   public:
@@ -95,9 +106,23 @@ class OpenFile {
     }
 
 
-    FileHeader *hdr;			// Header for this file 
+    FileHeader *hdr;			// Header for this file, shared by
+					// all of its OpenFiles
     int seekPosition;			// Current position within the file
     int headSector;
+
+  private:
+    RWLock *lock;			// the file's lock, shared by all of 
+					// its OpenFiles; readers share it
+    Lock *readAheadLock;		// protects the read-ahead state
+    int readAheadNext;			// where a sequential read would start
+    int readAheadWindow;		// sectors to stay ahead, 0 if the
+					// reads are not sequential
+    int readAheadEnd;			// last file sector already queued
+					// for read-ahead
+    void ReadAhead(int position, int numBytes, int lastSector);
+					// detect sequential reads and
+					// prefetch the sectors after them
 };
 
 #endif // FILESYS
@@ -5,10 +5,19 @@
 //	the disk providing a synchronous interface (requests wait until
 //	the request completes).
 //
-//	Use a semaphore to synchronize the interrupt handlers with the
-//	pending requests.  And, because the physical disk can only
-//	handle one operation at a time, use a lock to enforce mutual
-//	exclusion.
+//	Each request carries its own semaphore, which the interrupt
+//	handler signals when the request completes.  Because the
+//	physical disk can only handle one operation at a time, requests
+//	that arrive while the disk is busy are queued, and the interrupt
+//	handler starts the next one chosen by the scheduling policy
+//	(FIFO, SSTF, SCAN or C-LOOK).
+//
+//	Sectors pass through a buffer cache of fixed size.  Lookups are
+//	by hash on the sector number, replacement is LRU, and modified
+//	sectors are only written to disk when they are evicted or when
+//	Flush is called (at the latest from Cleanup).  A kernel thread
+//	reads sectors into the cache ahead of sequential readers
+//	(cf. OpenFile::ReadAt).
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -16,6 +25,8 @@
 
 #include "copyright.h"
 #include "synchdisk.h"
+#include "filehdr.h"
+#include "system.h"
 
 //----------------------------------------------------------------------
 // DiskRequestDone
@@ -31,39 +42,95 @@ DiskRequestDone (int arg)
     disk->RequestDone();
 }
 
+//----------------------------------------------------------------------
+// DiskRequest::DiskRequest
+// 	Set up a request to read or write one sector.
+//----------------------------------------------------------------------
+
+DiskRequest::DiskRequest(int sectorNumber, char* buffer, bool isWrite)
+{
+    sector = sectorNumber;
+    data = buffer;
+    writing = isWrite;
+    arrival = finish = 0;
+    done = new Semaphore("disk request", 0);
+    next = NULL;
+}
+
+DiskRequest::~DiskRequest()
+{
+    delete done;
+}
+
 //----------------------------------------------------------------------
 // SynchDisk::SynchDisk
 // 	Initialize the synchronous interface to the physical disk, in turn
-//	initializing the physical disk.
+//	initializing the physical disk.  All cache frames start out empty.
 //
 //	"name" -- UNIX file name to be used as storage for the disk data
 //	   (usually, "DISK")
+//	"cacheFrames" -- number of sectors held in the buffer cache
+//	"schedPolicy" -- order in which queued requests are served
 //----------------------------------------------------------------------
 
-SynchDisk::SynchDisk(char* name)
+SynchDisk::SynchDisk(char* name, int cacheFrames, DiskSchedPolicy schedPolicy)
 {
-    semaphore = new Semaphore("synch disk", 0);
-    lock = new Lock("synch disk lock");
     disk = new Disk(name, DiskRequestDone, (int) this);
+    policy = schedPolicy;
+    queue = active = NULL;
+    headSector = 0;
+    sweepUp = TRUE;
+
+    lock = new Lock("synch disk lock");
+    frameFree = new Condition("cache frame free");
+    ASSERT(cacheFrames >= 0);
+    numFrames = cacheFrames;
+    frames = NULL;
+    hashTable = NULL;
+    lruHead = lruTail = NULL;
+    readAheadQueue = NULL;
+    if (numFrames == 0)
+	return;
+
+    frames = new CacheFrame[numFrames];
+    hashTable = new CacheFrame *[numFrames];
+    for (int i = 0; i < numFrames; i++) {
+	frames[i].sector = -1;
+	frames[i].dirty = frames[i].busy = frames[i].prefetched = FALSE;
+	frames[i].hashNext = NULL;
+	frames[i].lruPrev = (i > 0) ? &frames[i - 1] : NULL;
+	frames[i].lruNext = (i < numFrames - 1) ? &frames[i + 1] : NULL;
+	hashTable[i] = NULL;
+    }
+    lruHead = &frames[0];
+    lruTail = &frames[numFrames - 1];
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::~SynchDisk
 // 	De-allocate data structures needed for the synchronous disk
-//	abstraction.
+//	abstraction.  Dirty frames must already have been flushed.
 //----------------------------------------------------------------------
 
 SynchDisk::~SynchDisk()
 {
-    delete disk;
+    ASSERT(active == NULL && queue == NULL);
+    delete [] frames;
+    delete [] hashTable;
+    delete frameFree;
     delete lock;
-    delete semaphore;
+    delete disk;
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::ReadSector
 // 	Read the contents of a disk sector into a buffer.  Return only
-//	after the data has been read.
+//	after the data has been read, either from the cache or from the
+//	disk.
+//
+//	The cache lock is not held while waiting for the disk, so other
+//	threads can use the cache (and queue their own requests) in the
+//	meantime; the frame being filled is marked busy instead.
 //
 //	"sectorNumber" -- the disk sector to read
 //	"data" -- the buffer to hold the contents of the disk sector
@@ -72,16 +139,50 @@ SynchDisk::~SynchDisk()
 void
 SynchDisk::ReadSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->ReadRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
+    CacheFrame *frame;
+
+    if (numFrames == 0) {
+	DoRequest(sectorNumber, data, FALSE);
+	return;
+    }
+
+    lock->Acquire();
+    for (;;) {
+	frame = Lookup(sectorNumber);
+	if (frame != NULL) {
+	    if (frame->busy) {			// being filled or written back
+		frameFree->Wait(lock);
+		continue;
+	    }
+	    stats->numCacheHits++;
+	    if (frame->prefetched) {		// read-ahead paid off
+		stats->numReadAheadHits++;
+		frame->prefetched = FALSE;
+	    }
+	    break;
+	}
+	frame = GetFrame(sectorNumber);
+	if (frame == NULL)			// had to wait; look again
+	    continue;
+	stats->numCacheMisses++;
+	frame->busy = TRUE;
+	lock->Release();
+	DoRequest(sectorNumber, frame->data, FALSE);
+	lock->Acquire();
+	ReleaseFrame(frame);
+	break;
+    }
+    bcopy(frame->data, data, SectorSize);
+    MoveToFront(frame);
     lock->Release();
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::WriteSector
-// 	Write the contents of a buffer into a disk sector.  Return only
-//	after the data has been written.
+// 	Write the contents of a buffer into a disk sector.  The sector
+//	is only written into the cache and marked dirty; it reaches the
+//	disk when the frame is evicted or flushed.  Since the whole 
+//	sector is overwritten, a miss does not need to read it first.
 //
 //	"sectorNumber" -- the disk sector to be written
 //	"data" -- the new contents of the disk sector
@@ -90,87 +191,517 @@ SynchDisk::ReadSector(int sectorNumber, char* data)
 void
 SynchDisk::WriteSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->WriteRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
+    CacheFrame *frame;
+
+    if (numFrames == 0) {
+	DoRequest(sectorNumber, data, TRUE);
+	return;
+    }
+
+    lock->Acquire();
+    for (;;) {
+	frame = Lookup(sectorNumber);
+	if (frame != NULL) {
+	    if (frame->busy) {
+		frameFree->Wait(lock);
+		continue;
+	    }
+	    stats->numCacheHits++;
+	    frame->prefetched = FALSE;
+	    break;
+	}
+	frame = GetFrame(sectorNumber);
+	if (frame != NULL) {
+	    stats->numCacheMisses++;
+	    break;
+	}
+    }
+    bcopy(data, frame->data, SectorSize);
+    frame->dirty = TRUE;
+    MoveToFront(frame);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Flush
+// 	Write every dirty frame in the buffer cache back to the disk.
+//	The frames stay cached (and clean).
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Flush()
+{
+    lock->Acquire();
+    for (int i = 0; i < numFrames; i++) {
+	while (frames[i].busy)
+	    frameFree->Wait(lock);
+	if (frames[i].dirty)
+	    WriteBack(&frames[i]);
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// ReadAheadThread
+// 	Body of the read-ahead kernel thread.  Need this to be a C
+//	routine, because Thread::Fork can't take a member function.
+//
+//	"arg" -- the SynchDisk whose cache is filled
+//----------------------------------------------------------------------
+
+static void
+ReadAheadThread(int arg)
+{
+    SynchDisk* disk = (SynchDisk *)arg;
+
+    disk->ServeReadAheads();
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ServeReadAheads
+// 	Forever take a sector off the read-ahead queue and bring it into
+//	the buffer cache.  The thread just blocks when there is nothing 
+//	to do, so it does not keep Nachos from halting.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::ServeReadAheads()
+{
+    for (;;)
+	Prefetch((int) readAheadQueue->Remove());
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ReadAhead
+// 	Queue a sector for the read-ahead thread, which is started the
+//	first time it is needed.  Returns right away; the caller does
+//	not wait for the sector to be read.  Does nothing if the buffer
+//	cache is disabled.
+//
+//	"sectorNumber" -- the disk sector that will probably be read soon
+//----------------------------------------------------------------------
+
+void
+SynchDisk::ReadAhead(int sectorNumber)
+{
+    if (numFrames == 0)
+	return;
+    if (readAheadQueue == NULL) {
+	readAheadQueue = new SynchList;
+	Thread *t = new Thread("read ahead");
+	t->Fork(ReadAheadThread, (int) this);
+    }
+    readAheadQueue->Append((void *) sectorNumber);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Prefetch
+// 	Read a sector into the buffer cache, unless it is already there
+//	(or on its way).  The frame is marked prefetched, so that the
+//	first ReadSector to find it counts as a read-ahead hit.
+//
+//	"sectorNumber" -- the disk sector to bring in
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Prefetch(int sectorNumber)
+{
+    CacheFrame *frame;
+
+    lock->Acquire();
+    do {
+	if (Lookup(sectorNumber) != NULL) {	// nothing to do
+	    lock->Release();
+	    return;
+	}
+	frame = GetFrame(sectorNumber);
+    } while (frame == NULL);
+    stats->numReadAheads++;
+    frame->busy = TRUE;
+    lock->Release();
+    DoRequest(sectorNumber, frame->data, FALSE);
+    lock->Acquire();
+    frame->prefetched = TRUE;
+    ReleaseFrame(frame);
+    MoveToFront(frame);
     lock->Release();
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::RequestDone
-// 	Disk interrupt handler.  Wake up any thread waiting for the disk
-//	request to finish.
+// 	Disk interrupt handler.  Start the next queued request, if any,
+//	and wake up the thread waiting for the one that just finished.
 //----------------------------------------------------------------------
 
 void
 SynchDisk::RequestDone()
 { 
-    semaphore->V();
+    DiskRequest *request = active;
+
+    ASSERT(request != NULL);
+    request->finish = stats->totalTicks;
+    active = NULL;
+    if (queue != NULL)
+	StartRequest(NextRequest());
+    request->done->V();
 }
 
+//----------------------------------------------------------------------
+// SynchDisk::DoRequest
+// 	Queue a request for the raw disk and wait for it to complete.
+//	If the disk is idle the request is started right away.  The
+//	queue is shared with the interrupt handler, so it is only
+//	touched with interrupts off.
+//
+//	"sectorNumber" -- the disk sector to read/write
+//	"data" -- the buffer to transfer from/into
+//	"writing" -- TRUE for a write, FALSE for a read
+//----------------------------------------------------------------------
 
+void
+SynchDisk::DoRequest(int sectorNumber, char* data, bool writing)
+{
+    DiskRequest *request = new DiskRequest(sectorNumber, data, writing);
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
 
-SynchFiles::SynchFiles() {
-    table = new FileStatus[NumFileStatus];
+    request->arrival = stats->totalTicks;
+    if (active == NULL)
+	StartRequest(request);
+    else {					// append, keeping arrival order
+	DiskRequest **ptr = &queue;
+	while (*ptr != NULL)
+	    ptr = &(*ptr)->next;
+	*ptr = request;
+    }
+    request->done->P();				// wait for interrupt
+    (void) interrupt->SetLevel(oldLevel);
+
+    stats->RecordDiskLatency(request->finish - request->arrival);
+    delete request;
 }
 
-bool
-SynchFiles::OpenFile(int sector) {
-    int i;
-    // find if the file is already opened
-    for (i = 0; i < NumFileStatus; i++) {
-        if (table[i].numOpened > 0 && table[i].fileSector == sector) {
-            table[i].numOpened++;
-
-            return true;
-        }
+//----------------------------------------------------------------------
+// SynchDisk::StartRequest
+// 	Hand a request to the (idle) disk device.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::StartRequest(DiskRequest *request)
+{
+    ASSERT(active == NULL);
+    active = request;
+    headSector = request->sector;
+    if (request->writing)
+	disk->WriteRequest(request->sector, request->data);
+    else
+	disk->ReadRequest(request->sector, request->data);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::NextRequest
+// 	Remove and return the queued request to serve next, according
+//	to the scheduling policy.  The queue must not be empty.
+//----------------------------------------------------------------------
+
+DiskRequest *
+SynchDisk::NextRequest()
+{
+    DiskRequest **best = &queue, **ptr, *request;
+    int headTrack = headSector / SectorsPerTrack;
+
+    ASSERT(queue != NULL);
+    switch (policy) {
+      case DiskFIFO:
+	break;
+      case DiskSSTF: {
+	int bestTime = disk->ComputeLatency(queue->sector, queue->writing);
+	for (ptr = &queue->next; *ptr != NULL; ptr = &(*ptr)->next) {
+	    int time = disk->ComputeLatency((*ptr)->sector, (*ptr)->writing);
+	    if (time < bestTime) {
+		best = ptr;
+		bestTime = time;
+	    }
+	}
+	break;
+      }
+      case DiskSCAN:
+	best = Sweep(headTrack, sweepUp);
+	if (best == NULL) {			// nothing ahead: turn around
+	    sweepUp = !sweepUp;
+	    best = Sweep(headTrack, sweepUp);
+	}
+	break;
+      case DiskCLOOK:
+	best = Sweep(headTrack, TRUE);
+	if (best == NULL)			// wrap to the lowest request
+	    best = Sweep(0, TRUE);
+	break;
     }
 
-    //find unuse slot
-    for (i = 0; i < NumFileStatus; i++) {
-        if (table[i].numOpened == 0) {
-            table[i].numOpened = 1;
-            table[i].fileSector = sector;
-            return true;
-        }
+    request = *best;
+    *best = request->next;
+    request->next = NULL;
+    return request;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Sweep
+// 	Find the queued request nearest to "track" among those at or
+//	beyond it in the given direction.  Return a pointer to the link
+//	that refers to it (so the caller can unlink it), or NULL if
+//	there is none.  Ties go to the earliest arrival.
+//
+//	"track" -- where the sweep starts
+//	"up" -- TRUE to look at higher sectors, FALSE for lower ones
+//----------------------------------------------------------------------
+
+DiskRequest **
+SynchDisk::Sweep(int track, bool up)
+{
+    DiskRequest **best = NULL, **ptr;
+
+    for (ptr = &queue; *ptr != NULL; ptr = &(*ptr)->next) {
+	int sector = (*ptr)->sector;
+	int reqTrack = sector / SectorsPerTrack;
+
+	if (up ? (reqTrack < track) : (reqTrack > track))
+	    continue;
+	if (best == NULL || (up ? (sector < (*best)->sector)
+				: (sector > (*best)->sector)))
+	    best = ptr;
+    }
+    return best;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Lookup
+// 	Return the frame caching "sectorNumber", or NULL if it is not
+//	in the cache.
+//----------------------------------------------------------------------
+
+CacheFrame *
+SynchDisk::Lookup(int sectorNumber)
+{
+    CacheFrame *frame;
+
+    for (frame = hashTable[sectorNumber % numFrames]; frame != NULL;
+						frame = frame->hashNext)
+	if (frame->sector == sectorNumber)
+	    return frame;
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::GetFrame
+// 	Take the least recently used frame that is not busy and rebind
+//	it to "sectorNumber".  The caller fills in the data.
+//
+//	If every frame is busy, or the victim is dirty and has to be
+//	written back first, the lock is given up while waiting and NULL
+//	is returned: another thread may have brought "sectorNumber" in 
+//	by then, so the caller must look it up again.
+//----------------------------------------------------------------------
+
+CacheFrame *
+SynchDisk::GetFrame(int sectorNumber)
+{
+    CacheFrame *frame = lruTail;
+
+    while (frame != NULL && frame->busy)
+	frame = frame->lruPrev;
+    if (frame == NULL) {			// everything is in use
+	frameFree->Wait(lock);
+	return NULL;
+    }
+    if (frame->dirty) {
+	WriteBack(frame);
+	return NULL;
+    }
+
+    if (frame->sector != -1)
+	HashRemove(frame);
+    frame->sector = sectorNumber;
+    frame->prefetched = FALSE;
+    frame->hashNext = hashTable[sectorNumber % numFrames];
+    hashTable[sectorNumber % numFrames] = frame;
+    return frame;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::WriteBack
+// 	Write a dirty frame to the disk.  The frame is busy while the
+//	write is outstanding, so nobody modifies or evicts it.  Called
+//	and returns with "lock" held.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::WriteBack(CacheFrame *frame)
+{
+    ASSERT(frame->dirty && !frame->busy);
+    frame->busy = TRUE;
+    lock->Release();
+    DoRequest(frame->sector, frame->data, TRUE);
+    lock->Acquire();
+    frame->dirty = FALSE;
+    stats->numCacheWritebacks++;
+    ReleaseFrame(frame);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ReleaseFrame
+// 	The disk request on a busy frame has finished; let any thread
+//	waiting for a frame try again.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::ReleaseFrame(CacheFrame *frame)
+{
+    frame->busy = FALSE;
+    frameFree->Broadcast(lock);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::HashRemove
+// 	Unlink a frame from its hash bucket.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::HashRemove(CacheFrame *frame)
+{
+    CacheFrame **ptr = &hashTable[frame->sector % numFrames];
+
+    while (*ptr != frame) {
+	ASSERT(*ptr != NULL);
+	ptr = &(*ptr)->hashNext;
     }
+    *ptr = frame->hashNext;
+    frame->hashNext = NULL;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::MoveToFront
+// 	Move a frame to the head of the LRU list.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::MoveToFront(CacheFrame *frame)
+{
+    if (frame == lruHead)
+	return;
+
+    frame->lruPrev->lruNext = frame->lruNext;	// unlink
+    if (frame == lruTail)
+	lruTail = frame->lruPrev;
+    else
+	frame->lruNext->lruPrev = frame->lruPrev;
+
+    frame->lruPrev = NULL;			// and push at the head
+    frame->lruNext = lruHead;
+    lruHead->lruPrev = frame;
+    lruHead = frame;
+}
+
+
+
+//----------------------------------------------------------------------
+// SynchFiles::SynchFiles
+// 	Initialize an empty table of open files.
+//----------------------------------------------------------------------
+
+SynchFiles::SynchFiles() {
+    for (int i = 0; i < NumFileBuckets; i++)
+        table[i] = NULL;
+}
+
+//----------------------------------------------------------------------
+// SynchFiles::Find
+// 	Return the link that points to the entry for the file whose header
+//	is in "sector", or the NULL link at the end of its bucket if the
+//	file isn't open.
+//----------------------------------------------------------------------
+
+FileStatus **
+SynchFiles::Find(int sector) {
+    FileStatus **ptr = &table[sector % NumFileBuckets];
+
+    while (*ptr != NULL && (*ptr)->fileSector != sector)
+        ptr = &(*ptr)->hashNext;
+    return ptr;
+}
+
+//----------------------------------------------------------------------
+// FileStatus::~FileStatus
+// 	Free the file's in-memory header, once the file is closed.
+//----------------------------------------------------------------------
+
+FileStatus::~FileStatus() {
+    delete hdr;
+    delete lock;
+}
+
+//----------------------------------------------------------------------
+// SynchFiles::OpenFile, CloseFile
+// 	Count one more, or one less, OpenFile on the file whose header is 
+//	in "sector", making or removing its table entry as need be.
+//	OpenFile returns the entry, so that the caller can keep its lock
+//	and share its header.
+//
+//	The first open reads the header, and its whole sector map, from
+//	disk.  That blocks, so the entry is only linked in once the header
+//	is complete; if another thread opened the file in the meantime,
+//	its entry is used instead.
+//----------------------------------------------------------------------
+
+FileStatus *
+SynchFiles::OpenFile(int sector) {
+    FileStatus **ptr = Find(sector);
+    FileHeader *hdr;
 
-    //open failed
-    return false;
+    if (*ptr == NULL) {                     // first open
+        hdr = new FileHeader;
+        hdr->FetchFrom(sector);
+        hdr->LoadSectorMap();               // now, so that readers sharing
+                                            // it never load it together
+        ptr = Find(sector);                 // the table may have changed
+        if (*ptr == NULL)
+            *ptr = new FileStatus(sector, hdr);
+        else
+            delete hdr;
+    }
+    (*ptr)->numOpened++;
+    return *ptr;
 }
 
 bool 
 SynchFiles::CloseFile(int sector) {
-    int i;
-    for (i = 0; i < NumFileStatus; i++) {
-        if (table[i].numOpened > 0 && table[i].fileSector == sector) {
-            table[i].numOpened--;
-            return true;
+    FileStatus **ptr = Find(sector);
+    FileStatus *status = *ptr;
 
-        }
+    if (status == NULL)
+        return false;
+    if (--status->numOpened == 0) {         // last close
+        *ptr = status->hashNext;
+        delete status;
     }
-
-    return false;
+    return true;
 }
 
+//----------------------------------------------------------------------
+// SynchFiles::GetOpenNum, GetLock
+// 	Return how many OpenFiles there are on the file whose header is 
+//	in "sector", and its lock (NULL if it isn't open).
+//----------------------------------------------------------------------
+
 int
 SynchFiles::GetOpenNum(int sector) {
-    int i;
-    for (i = 0; i < NumFileStatus; i++) {
-        if (table[i].numOpened > 0 && table[i].fileSector == sector) {
-            return table[i].numOpened;
-        }
-    }
-    return 0;
+    FileStatus *status = *Find(sector);
+
+    return (status == NULL) ? 0 : status->numOpened;
 }
 
-Lock*
+RWLock*
 SynchFiles::GetLock(int sector) {
-    int i;
-    for (i = 0; i < NumFileStatus; i++) {
-        if (table[i].numOpened > 0 && table[i].fileSector == sector) {
-            return table[i].lock;
-        }   
-    }
-    return NULL;
-}
\ No newline at end of file
+    FileStatus *status = *Find(sector);
+
+    return (status == NULL) ? NULL : status->lock;
+}
@@ -13,6 +13,57 @@
 
 #include "disk.h"
 #include "synch.h"
+#include "synchlist.h"
+
+// A buffer cache frame holds the contents of one disk sector.  Frames
+// are chained into a hash bucket (for lookup by sector number) and
+// into a doubly linked LRU list (most recently used at the head).
+// A frame is "busy" while a disk request on its data is outstanding;
+// other threads wanting the frame wait until it is released.  A frame
+// filled by read-ahead is marked "prefetched" until it is first read.
+
+#define DefaultCacheFrames	32	// sector frames in the buffer cache
+
+class CacheFrame {
+  public:
+    int sector;				// disk sector held, -1 if none
+    bool dirty;				// modified since read from disk?
+    bool busy;				// being read or written back?
+    bool prefetched;			// read ahead, not yet asked for?
+    CacheFrame *hashNext;		// next frame in the same bucket
+    CacheFrame *lruPrev;		// towards the most recently used
+    CacheFrame *lruNext;		// towards the least recently used
+    char data[SectorSize];		// cached copy of the sector
+};
+
+// The order in which queued disk requests are sent to the device.
+
+enum DiskSchedPolicy {
+    DiskFIFO,		// in order of arrival
+    DiskSSTF,		// shortest positioning time (seek + rotation) first
+    DiskSCAN,		// elevator: sweep up, then down, reversing
+			// at the last request in each direction
+    DiskCLOOK		// sweep up only, then jump back to the lowest
+			// outstanding request
+};
+
+// One outstanding request to the disk device.  The requesting thread
+// waits on "done", which the interrupt handler signals when the
+// request completes.
+
+class DiskRequest {
+  public:
+    DiskRequest(int sectorNumber, char* buffer, bool isWrite);
+    ~DiskRequest();
+
+    int sector;				// sector to read or write
+    char *data;				// buffer to transfer from/into
+    bool writing;			// write (TRUE) or read (FALSE)?
+    int arrival;			// totalTicks when the request was queued
+    int finish;				// totalTicks when it completed
+    Semaphore *done;			// signalled on completion
+    DiskRequest *next;			// next request in the queue
+};
 
 // The following class defines a "synchronous" disk abstraction.
 // As with other I/O devices, the raw physical disk is an asynchronous device --
@@ -23,20 +74,37 @@
 //
 // This class provides the abstraction that for any individual thread
 // making a request, it waits around until the operation finishes before
-// returning.
+// returning.  Requests from different threads are queued, and whenever
+// the device becomes free the next one is picked by the scheduling
+// policy.
+//
+// Sectors are kept in a write-back buffer cache with LRU replacement,
+// so a WriteSector may not reach the disk until the frame is evicted
+// or Flush is called.
 class SynchDisk {
   public:
-    SynchDisk(char* name);    		// Initialize a synchronous disk,
+    SynchDisk(char* name, int cacheFrames = DefaultCacheFrames,
+	      DiskSchedPolicy schedPolicy = DiskCLOOK);
+    					// Initialize a synchronous disk,
 					// by initializing the raw Disk.
+					// "cacheFrames" of 0 disables
+					// the buffer cache.
     ~SynchDisk();			// De-allocate the synch disk data
     
     void ReadSector(int sectorNumber, char* data);
     					// Read/write a disk sector, returning
     					// only once the data is actually read 
-					// or written.  These call
-    					// Disk::ReadRequest/WriteRequest and
-					// then wait until the request is done.
+					// or written (into the cache).  Misses
+    					// queue a request for the disk
+					// and then wait until it is done.
     void WriteSector(int sectorNumber, char* data);
+    void Flush();			// Write every dirty cache frame
+					// back to the disk
+    void ReadAhead(int sectorNumber);	// Ask the read-ahead thread to
+					// bring a sector into the cache
+    void Prefetch(int sectorNumber);	// Bring a sector into the cache
+					// without copying it anywhere
+    void ServeReadAheads();		// Body of the read-ahead thread
     
     void RequestDone();			// Called by the disk device interrupt
 					// handler, to signal that the
@@ -44,37 +112,88 @@ class SynchDisk {
 
   private:
     Disk *disk;		  		// Raw disk device
-    Semaphore *semaphore; 		// To synchronize requesting thread 
-					// with the interrupt handler
-    Lock *lock;		  		// Only one read/write request
-					// can be sent to the disk at a time
+
+    DiskSchedPolicy policy;		// how to pick the next request
+    DiskRequest *queue;			// requests waiting for the device,
+					// in order of arrival
+    DiskRequest *active;		// request the device is working on,
+					// NULL if the device is idle
+    int headSector;			// last sector sent to the device
+    bool sweepUp;			// SCAN direction
+
+    void DoRequest(int sectorNumber, char* data, bool writing);
+					// queue a request and wait for it
+    void StartRequest(DiskRequest *request);	// send it to the device
+    DiskRequest *NextRequest();		// remove the next request to
+					// serve from the queue
+    DiskRequest **Sweep(int track, bool up);	// nearest request at or
+					// beyond "track" in one direction
+
+    Lock *lock;		  		// Protects the buffer cache
+    Condition *frameFree;		// Signalled when a busy frame
+					// is released
+    int numFrames;			// size of the buffer cache
+    CacheFrame *frames;			// the sector frames
+    CacheFrame **hashTable;		// buckets, indexed by sector % numFrames
+    CacheFrame *lruHead, *lruTail;	// most/least recently used frame
+    SynchList *readAheadQueue;		// sectors for the read-ahead thread,
+					// NULL until the thread is started
+
+    CacheFrame *Lookup(int sectorNumber);	// find a cached sector
+    CacheFrame *GetFrame(int sectorNumber);	// evict the LRU frame and
+						// rebind it to "sectorNumber"
+    void WriteBack(CacheFrame *frame);	// write a dirty frame to disk
+    void ReleaseFrame(CacheFrame *frame);	// clear busy, wake waiters
+    void HashRemove(CacheFrame *frame);
+    void MoveToFront(CacheFrame *frame);	// mark frame most recently used
 };
 
 //----------------------------add in lab 6------------------------//
-#define NumFileStatus 100
+// The in-core inode table: one FileStatus for each file that is open,
+// however many times, found by the sector of its file header through a
+// hash table.  A FileStatus is made when the file is first opened, and
+// goes away when the last OpenFile on it is closed.  It holds the one
+// in-memory copy of the file header, which all the OpenFiles share.
+//
+// The table is never changed across a blocking call, so it needs no
+// lock of its own.
+
+#define NumFileBuckets 64
+
+class FileHeader;
 
 class FileStatus
 {
 public:
-    int numOpened;          //0 means no used
+    int numOpened;          //number of OpenFiles on the file
     int fileSector;             //the secotr of open file's header,which is using for index
-    Lock *lock;
-    FileStatus() {
-        numOpened = 0;      //not used
-        lock = new Lock("single file lock");
+    FileHeader *hdr;        //the file header, with its sector map
+    RWLock *lock;           //readers share it, a writer holds it alone
+    FileStatus *hashNext;   //next file in the same bucket
+    FileStatus(int sector, FileHeader *header) {
+        numOpened = 0;
+        fileSector = sector;
+        hdr = header;
+        lock = new RWLock("single file lock");
+        hashNext = NULL;
     }
+    ~FileStatus();          //frees the header and the lock
 };
 
 class SynchFiles
 {
 public:
-    FileStatus *table;
-  
-    bool OpenFile(int sector);           //  open file in "sector"  
+    FileStatus *OpenFile(int sector);    //  open file in "sector", and
+                                         //  return its table entry
     bool CloseFile(int sector);          //  close file in "sector"
     int GetOpenNum(int sector);         //  get the file open num
-    Lock *GetLock(int sector);          //  get the file lock in "sector"
+    RWLock *GetLock(int sector);        //  get the file lock in "sector"
     SynchFiles();                    //  constructor
+
+private:
+    FileStatus *table[NumFileBuckets];  //  buckets, by sector
+    FileStatus **Find(int sector);      //  where the file's entry is, 
+                                        //  or would be linked in
 };
 
 //----------------------------finish add-------------------------//
@@ -60,7 +60,11 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, int param, int time,
 Interrupt::Interrupt()
 {
     level = IntOff;
-    pending = new List();
+    maxPending = PendingPoolSize;
+    pending = new PendingInterrupt *[maxPending];
+    numPending = 0;
+    nextSeq = 0;
+    freeList = NULL;
     inHandler = FALSE;
     yieldOnReturn = FALSE;
     status = SystemMode;
@@ -73,9 +77,9 @@ Interrupt::Interrupt()
 
 Interrupt::~Interrupt()
 {
-    while (!pending->IsEmpty())
-	delete (PendingInterrupt *)pending->Remove();
-    delete pending;
+    // The PendingInterrupts themselves were allocated in blocks by
+    // NewPending, and are not freed individually.
+    delete [] pending;
 }
 
 //----------------------------------------------------------------------
@@ -145,20 +149,21 @@ Interrupt::Enable()
 //
 //	Two things can cause OneTick to be called:
 //		interrupts are re-enabled
-//		a user instruction is executed
+//		a user instruction (or a basic block of "count" user
+//		instructions, cf. Machine::RunBlock) is executed
 //----------------------------------------------------------------------
 void
-Interrupt::OneTick()
+Interrupt::OneTick(int count)
 {
     MachineStatus old = status;
 
 // advance simulated time
     if (status == SystemMode) {
-        stats->totalTicks += SystemTick;
-	stats->systemTicks += SystemTick;
+        stats->totalTicks += count * SystemTick;
+	stats->systemTicks += count * SystemTick;
     } else {					// USER_PROGRAM
-	stats->totalTicks += UserTick;
-	stats->userTicks += UserTick;
+	stats->totalTicks += count * UserTick;
+	stats->userTicks += count * UserTick;
     }
     DEBUG('i', "\n== Tick %d ==\n", stats->totalTicks);
 
@@ -265,13 +270,17 @@ void
 Interrupt::Schedule(VoidFunctionPtr handler, int arg, int fromNow, IntType type)
 {
     int when = stats->totalTicks + fromNow;
-    PendingInterrupt *toOccur = new PendingInterrupt(handler, arg, when, type);
+    PendingInterrupt *toOccur = NewPending();
 
     DEBUG('i', "Scheduling interrupt handler the %s at time = %d\n", 
 					intTypeNames[type], when);
     ASSERT(fromNow > 0);
 
-    pending->SortedInsert(toOccur, when);
+    toOccur->handler = handler;
+    toOccur->arg = arg;
+    toOccur->when = when;
+    toOccur->type = type;
+    HeapInsert(toOccur);
 }
 
 //----------------------------------------------------------------------
@@ -297,26 +306,26 @@ Interrupt::CheckIfDue(bool advanceClock)
 					// to invoke an interrupt handler
     if (DebugIsEnabled('i'))
 	DumpState();
-    PendingInterrupt *toOccur = 
-		(PendingInterrupt *)pending->SortedRemove(&when);
-
-    if (toOccur == NULL)		// no pending interrupts
+    if (numPending == 0)		// no pending interrupts
 	return FALSE;			
 
+    // look at the earliest interrupt without removing it, so that 
+    // there is nothing to put back if it is not due yet
+    PendingInterrupt *toOccur = pending[0];
+    when = toOccur->when;
+
     if (advanceClock && when > stats->totalTicks) {	// advance the clock
 	stats->idleTicks += (when - stats->totalTicks);
 	stats->totalTicks = when;
-    } else if (when > stats->totalTicks) {	// not time yet, put it back
-	pending->SortedInsert(toOccur, when);
+    } else if (when > stats->totalTicks)	// not time yet
 	return FALSE;
-    }
 
 // Check if there is nothing more to do, and if so, quit
     if ((status == IdleMode) && (toOccur->type == TimerInt) 
-				&& pending->IsEmpty()) {
-	 pending->SortedInsert(toOccur, when);
+				&& numPending == 1)
 	 return FALSE;
-    }
+
+    HeapRemove();
 
     DEBUG('i', "Invoking interrupt handler for the %s at time %d\n", 
 			intTypeNames[toOccur->type], toOccur->when);
@@ -331,10 +340,119 @@ Interrupt::CheckIfDue(bool advanceClock)
     (*(toOccur->handler))(toOccur->arg);	// call the interrupt handler
     status = old;				// restore the machine status
     inHandler = FALSE;
-    delete toOccur;
+    FreePending(toOccur);
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// Interrupt::NewPending
+// 	Return an unused PendingInterrupt from the free list, refilling
+//	the free list with a block of PendingPoolSize nodes when it runs
+//	out.  Blocks are never returned to the heap allocator.
+//----------------------------------------------------------------------
+
+PendingInterrupt *
+Interrupt::NewPending()
+{
+    PendingInterrupt *p;
+
+    if (freeList == NULL) {
+	PendingInterrupt *block = new PendingInterrupt[PendingPoolSize];
+	for (int i = 0; i < PendingPoolSize; i++)
+	    FreePending(&block[i]);
+    }
+    p = freeList;
+    freeList = p->next;
+    return p;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::FreePending
+// 	Put a PendingInterrupt that has fired back on the free list.
+//----------------------------------------------------------------------
+
+void
+Interrupt::FreePending(PendingInterrupt *p)
+{
+    p->next = freeList;
+    freeList = p;
+}
+
+//----------------------------------------------------------------------
+// EarlierInterrupt
+// 	Heap ordering: by "when", and among interrupts due at the same
+//	time, by the order in which they were scheduled.  The sequence
+//	numbers are unsigned, and compared by their difference, so that
+//	wrap-around is harmless.
+//----------------------------------------------------------------------
+
+static bool
+EarlierInterrupt(PendingInterrupt *a, PendingInterrupt *b)
+{
+    if (a->when != b->when)
+	return a->when < b->when;
+    return (int) (a->seq - b->seq) < 0;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::HeapInsert
+// 	Add an interrupt to the pending heap, growing the heap array if
+//	it is full, and sift it up to its place.
+//----------------------------------------------------------------------
+
+void
+Interrupt::HeapInsert(PendingInterrupt *p)
+{
+    int i, parent;
+
+    if (numPending == maxPending) {
+	PendingInterrupt **old = pending;
+
+	maxPending *= 2;
+	pending = new PendingInterrupt *[maxPending];
+	for (i = 0; i < numPending; i++)
+	    pending[i] = old[i];
+	delete [] old;
+    }
+
+    p->seq = nextSeq++;
+    for (i = numPending++; i > 0; i = parent) {
+	parent = (i - 1) / 2;
+	if (!EarlierInterrupt(p, pending[parent]))
+	    break;
+	pending[i] = pending[parent];
+    }
+    pending[i] = p;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::HeapRemove
+// 	Remove and return the earliest pending interrupt; the last
+//	element of the heap is sifted down from the root to fill the hole.
+//----------------------------------------------------------------------
+
+PendingInterrupt *
+Interrupt::HeapRemove()
+{
+    PendingInterrupt *first, *last;
+    int i, child;
+
+    ASSERT(numPending > 0);
+    first = pending[0];
+    last = pending[--numPending];
+    for (i = 0; (child = 2 * i + 1) < numPending; i = child) {
+	if (child + 1 < numPending 
+		&& EarlierInterrupt(pending[child + 1], pending[child]))
+	    child++;
+	if (!EarlierInterrupt(pending[child], last))
+	    break;
+	pending[i] = pending[child];
+    }
+    if (numPending > 0)
+	pending[i] = last;
+    return first;
+}
+
 //----------------------------------------------------------------------
 // PrintPending
 // 	Print information about an interrupt that is scheduled to occur.
@@ -342,9 +460,8 @@ Interrupt::CheckIfDue(bool advanceClock)
 //----------------------------------------------------------------------
 
 static void
-PrintPending(int arg)
+PrintPending(PendingInterrupt *pend)
 {
-    PendingInterrupt *pend = (PendingInterrupt *)arg;
 
     printf("Interrupt handler %s, scheduled at %d\n", 
 	intTypeNames[pend->type], pend->when);
@@ -353,7 +470,9 @@ PrintPending(int arg)
 //----------------------------------------------------------------------
 // DumpState
 // 	Print the complete interrupt state - the status, and all interrupts
-//	that are scheduled to occur in the future.
+//	that are scheduled to occur in the future.  The interrupts are
+//	printed in heap order, which is not necessarily the order in
+//	which they will fire.
 //----------------------------------------------------------------------
 
 void
@@ -363,7 +482,8 @@ Interrupt::DumpState()
 					intLevelNames[level]);
     printf("Pending interrupts:\n");
     fflush(stdout);
-    pending->Mapcar(PrintPending);
+    for (int i = 0; i < numPending; i++)
+	PrintPending(pending[i]);
     printf("End of pending interrupts\n");
     fflush(stdout);
 }
@@ -55,9 +55,13 @@ enum IntType { TimerInt, DiskInt, ConsoleWriteInt, ConsoleReadInt,
 // The following class defines an interrupt that is scheduled
 // to occur in the future.  The internal data structures are
 // left public to make it simpler to manipulate.
+//
+// PendingInterrupts are recycled through a free list in Interrupt,
+// rather than being allocated and deleted for every event.
 
 class PendingInterrupt {
   public:
+    PendingInterrupt() {}	// uninitialized, for the free list
     PendingInterrupt(VoidFunctionPtr func, int param, int time, IntType kind);
 				// initialize an interrupt that will
 				// occur in the future
@@ -67,8 +71,13 @@ class PendingInterrupt {
     int arg;                    // The argument to the function.
     int when;			// When the interrupt is supposed to fire
     IntType type;		// for debugging
+    unsigned int seq;		// order of scheduling, so that interrupts
+				// due at the same time fire in FIFO order
+    PendingInterrupt *next;	// link in the free list
 };
 
+#define PendingPoolSize	64	// PendingInterrupts allocated at a time
+
 // The following class defines the data structures for the simulation
 // of hardware interrupts.  We record whether interrupts are enabled
 // or disabled, and any hardware interrupts that are scheduled to occur
@@ -110,12 +119,18 @@ class Interrupt {
 	int arg, int when, IntType type);// at time ``when''.  This is called
     					// by the hardware device simulators.
     
-    void OneTick();       		// Advance simulated time
+    void OneTick(int count = 1);	// Advance simulated time by "count"
+					// ticks
 
   private:
     IntStatus level;		// are interrupts enabled or disabled?
-    List *pending;		// the list of interrupts scheduled
-				// to occur in the future
+    PendingInterrupt **pending;	// the interrupts scheduled to occur in
+				// the future, as a binary min-heap
+				// ordered by (when, seq)
+    int numPending;		// number of interrupts in the heap
+    int maxPending;		// size of the heap array
+    unsigned int nextSeq;	// seq of the next interrupt scheduled
+    PendingInterrupt *freeList;	// recycled PendingInterrupts
     bool inHandler;		// TRUE if we are running an interrupt handler
     bool yieldOnReturn; 	// TRUE if we are to context switch
 				// on return from the interrupt handler
@@ -128,6 +143,11 @@ class Interrupt {
 
     void ChangeLevel(IntStatus old, 	// SetLevel, without advancing the
 	IntStatus now);  		// simulated time
+
+    PendingInterrupt *NewPending();	// take a node off the free list
+    void FreePending(PendingInterrupt *p);	// and put it back
+    void HeapInsert(PendingInterrupt *p);	// add to the pending heap
+    PendingInterrupt *HeapRemove();	// remove the earliest interrupt
 };
 
 #endif // INTERRRUPT_H
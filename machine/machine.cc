@@ -10,6 +10,7 @@
 #include "copyright.h"
 #include "machine.h"
 #include "system.h"
+#include "synch.h"
 
 // Textual names of the exceptions that can be generated by user program
 // execution, for debugging.
@@ -52,9 +53,10 @@ void CheckEndian()
 //
 //	"debug" -- if TRUE, drop into the debugger after each user instruction
 //		is executed.
+//	"blocks" -- if TRUE, run user code a basic block at a time
 //----------------------------------------------------------------------
 
-Machine::Machine(bool debug)
+Machine::Machine(bool debug, bool blocks)
 {
     int i;
 
@@ -63,18 +65,37 @@ Machine::Machine(bool debug)
     mainMemory = new char[MemorySize];
     for (i = 0; i < MemorySize; i++)
       	mainMemory[i] = 0;
+    decodeCache = new Instruction[DecodeCacheSize];
+    decodeValid = new bool[DecodeCacheSize];
+    blockTable = new Block *[DecodeCacheSize];
+    for (i = 0; i < DecodeCacheSize; i++) {
+	decodeValid[i] = FALSE;
+	blockTable[i] = NULL;
+    }
+    frameHasBlocks = new bool[NumPhysPages];
+    for (i = 0; i < NumPhysPages; i++)
+	frameHasBlocks[i] = FALSE;
+    runningBlock = NULL;
 #ifdef USE_TLB
 	DEBUG('a', "USE_TLB is open\n");
-	clockPos = 0;
+	ASSERT(TLBSize % TLBWays == 0);
+	clockPos = new int[TLBSets];
+	for (i = 0; i < TLBSets; i++)
+		clockPos[i] = 0;
 	tlb = new TranslationEntry[TLBSize];
-    for (i = 0; i < TLBSize; i++)
+    for (i = 0; i < TLBSize; i++) {
 	tlb[i].valid = FALSE;
+	tlb[i].asid = -1;
+    }
+    currentASID = 0;
     pageTable = NULL;
 #else	// use linear page table
     tlb = NULL;
     pageTable = NULL;
 #endif
 
+    FlushFastTranslations();
+    blockMode = blocks;
     singleStep = debug;
     CheckEndian();
 }
@@ -87,8 +108,17 @@ Machine::Machine(bool debug)
 Machine::~Machine()
 {
     delete [] mainMemory;
-    if (tlb != NULL)
+    delete [] decodeCache;
+    delete [] decodeValid;
+    for (int i = 0; i < DecodeCacheSize; i++)
+	if (blockTable[i] != NULL)
+	    delete blockTable[i];
+    delete [] blockTable;
+    delete [] frameHasBlocks;
+    if (tlb != NULL) {
         delete [] tlb;
+	delete [] clockPos;
+    }
 }
 
 //----------------------------------------------------------------------
@@ -109,8 +139,12 @@ Machine::RaiseException(ExceptionType which, int badVAddr)
 //  ASSERT(interrupt->getStatus() == UserMode);
     registers[BadVAddrReg] = badVAddr;
     DelayedLoad(0, 0);			// finish anything in progress
+    ReleaseBlock();			// the handler may never return
+					// (e.g. on Exit) to the block
     interrupt->setStatus(SystemMode);
     ExceptionHandler(which);		// interrupts are enabled at this point
+    FlushFastTranslations();		// the handler may have changed the
+					// TLB or the page table
     interrupt->setStatus(UserMode);
 }
 
@@ -216,106 +250,707 @@ void Machine::WriteRegister(int num, int value)
 	registers[num] = value;
     }
 
+//----------------------------------------------------------------------
+// Machine::FlushFastTranslations
+// 	Empty the simulator's cache of recent translations, so that the
+//	next reference to every page goes through Translate again.
+//----------------------------------------------------------------------
+
+void
+Machine::FlushFastTranslations()
+{
+    for (int i = 0; i < FastXlateSize; i++)
+	fastXlate[i].vpn = -1;
+}
+
+//----------------------------------------------------------------------
+// Machine::InvalidateDecoded
+// 	Called whenever a word of physical memory is modified, so that
+//	OneInstruction does not run a stale decoded copy of it.  Any
+//	basic block in the same frame is forgotten as well; it is simpler
+//	than finding just the ones that cover the word, and stores into
+//	code pages are rare.
+//
+//	"physAddr" -- the physical address written (any byte of the word)
+//----------------------------------------------------------------------
+
+void
+Machine::InvalidateDecoded(int physAddr)
+{
+    decodeValid[physAddr / 4] = FALSE;
+    if (frameHasBlocks[physAddr / PageSize])
+	InvalidateFrameDecoded(physAddr / PageSize);
+}
+
+//----------------------------------------------------------------------
+// Machine::InvalidateFrameDecoded
+// 	Called whenever the kernel replaces the contents of a page frame,
+//	e.g. when a page is loaded into it or evicted from it.
+//
+//	"frame" -- the physical page number
+//----------------------------------------------------------------------
+
+void
+Machine::InvalidateFrameDecoded(int frame)
+{
+    for (int i = frame * PageSize / 4; i < (frame + 1) * PageSize / 4; i++) {
+	decodeValid[i] = FALSE;
+	if (blockTable[i] != NULL) {
+	    DropBlock(blockTable[i]);
+	    blockTable[i] = NULL;
+	}
+    }
+    frameHasBlocks[frame] = FALSE;
+}
+
+//----------------------------------------------------------------------
+// WriteBackTLBEntry
+// 	A TLB entry is about to be replaced: fold the use and dirty bits
+//	the hardware has set in it back into the page table of its address
+//	space, which need not be the running one.
+//----------------------------------------------------------------------
+
+static void
+WriteBackTLBEntry(TranslationEntry *entry)
+{
+	if (!entry->valid || asidTable[entry->asid] == NULL)
+		return;
+	TranslationEntry *pte = 
+		&asidTable[entry->asid]->pageTable[entry->virtualPage];
+	pte->use |= entry->use;
+	pte->dirty |= entry->dirty;
+}
+
 bool Machine::tlbMiss_FIFO2(int vpn) {
-	for (int i = 0; i < TLBSize; i++) {
-		if (tlb[clockPos].valid == false) {
-			memcpy(&tlb[clockPos], &currentThread->space->pageTable[vpn], sizeof(TranslationEntry)); 
-			tlb[clockPos].use = true;
+	TranslationEntry *set = TLBSet(vpn);
+	int &pos = clockPos[vpn % TLBSets];	// this set's clock hand
+
+	for (int i = 0; i < TLBWays; i++) {
+		if (set[pos].valid == false) {
+			memcpy(&set[pos], &currentThread->space->pageTable[vpn], sizeof(TranslationEntry)); 
+			set[pos].use = true;
 			return true;
 		}
-		clockPos = (clockPos+1)%TLBSize;
+		pos = (pos+1)%TLBWays;
 	}
 
-	for (int i = 0; i < TLBSize; i++) {		
-		if (tlb[clockPos].use == false) {
-			memcpy(&tlb[clockPos], &currentThread->space->pageTable[vpn], sizeof(TranslationEntry)); 
-			tlb[clockPos].use = true;
+	for (int i = 0; i < TLBWays; i++) {		
+		if (set[pos].use == false) {
+			WriteBackTLBEntry(&set[pos]);
+			memcpy(&set[pos], &currentThread->space->pageTable[vpn], sizeof(TranslationEntry)); 
+			set[pos].use = true;
 			return true;
 		} else {
-			tlb[clockPos].use = false;
+			WriteBackTLBEntry(&set[pos]);
+			set[pos].use = false;
 		}
-		clockPos = (clockPos+1)%TLBSize;
+		pos = (pos+1)%TLBWays;
 	}
-	memcpy(&tlb[clockPos], &currentThread->space->pageTable[vpn], sizeof(TranslationEntry)); 
-	tlb[clockPos].use = true;
+	WriteBackTLBEntry(&set[pos]);
+	memcpy(&set[pos], &currentThread->space->pageTable[vpn], sizeof(TranslationEntry)); 
+	set[pos].use = true;
 	return true;
 }
 
+//----------------------------------------------------------------------
+// PhysMemoryManager::PhysMemoryManager
+// 	Initialize the frame table: every frame is free.
+//
+//	"replacement" -- how to choose a page to evict when none are free
+//----------------------------------------------------------------------
+
+PhysMemoryManager::PhysMemoryManager(ReplacementPolicy replacement)
+{
+	policy = replacement;
+	useArr = new bool[NumPhysPages];
+	spaceArr = new AddrSpace *[NumPhysPages];
+	vpnArr = new int[NumPhysPages];
+	refCount = new int[NumPhysPages];
+	freeFrames = new int[NumPhysPages];
+	age = new unsigned char[NumPhysPages];
+	cacheProgram = new int[NumPhysPages];
+	cacheNext = new int[NumPhysPages];
+	cacheBucket = new int[NumPhysPages];
+	numFree = 0;
+	for (int i = NumPhysPages - 1; i >= 0; i--) {
+		useArr[i] = false;
+		spaceArr[i] = NULL;
+		refCount[i] = 0;
+		age[i] = 0;
+		cacheProgram[i] = cacheNext[i] = cacheBucket[i] = -1;
+		freeFrames[numFree++] = i;
+	}
+	hand = 0;
+	totalQuota = 0;
+	memoryLock = new Lock("memory");
+	memoryFree = new Condition("memory free");
+}
+
+//----------------------------------------------------------------------
+// PhysMemoryManager::~PhysMemoryManager
+// 	De-allocate the frame table.
+//----------------------------------------------------------------------
+
+PhysMemoryManager::~PhysMemoryManager()
+{
+	delete [] useArr;
+	delete [] spaceArr;
+	delete [] vpnArr;
+	delete [] refCount;
+	delete [] freeFrames;
+	delete [] age;
+	delete [] cacheProgram;
+	delete [] cacheNext;
+	delete [] cacheBucket;
+	delete memoryLock;
+	delete memoryFree;
+}
+
+//----------------------------------------------------------------------
+// PhysMemoryManager::Entry
+// 	Return the page table entry of "space" for the page that 
+//	occupies "frame".
+//----------------------------------------------------------------------
+
+TranslationEntry *
+PhysMemoryManager::Entry(AddrSpace *space, int frame)
+{
+	return &space->pageTable[vpnArr[frame]];
+}
+
+//----------------------------------------------------------------------
+// PhysMemoryManager::Maps
+// 	Return TRUE if "space" has "frame" in its page table.  A frame
+//	shared after a fork is at the same virtual page in every space
+//	that maps it, but belongs (in spaceArr) to just one of them.
+//----------------------------------------------------------------------
+
+bool
+PhysMemoryManager::Maps(AddrSpace *space, int frame)
+{
+	TranslationEntry *entry;
+
+	if (!useArr[frame] || vpnArr[frame] >= (int) space->numPages)
+		return FALSE;
+	entry = Entry(space, frame);
+	return entry->valid && entry->physicalPage == frame;
+}
+
+//----------------------------------------------------------------------
+// PhysMemoryManager::FindVictim
+// 	Choose one of the frames of "owner" to evict; owner must hold at
+//	least one, and be the running process.
+//
+//	The hardware sets use bits in the TLB only, so first fold those
+//	of the running process into its page table, and clear them in
+//	the TLB, so that a page shows up as used again only if it is
+//	referenced again.
+//
+//	FIFO and clock advance the hand past a frame at a time, so the
+//	cost is O(1) amortized; enhanced clock makes at most four passes,
+//	and approximate LRU looks at every frame.
+//----------------------------------------------------------------------
+
+int
+PhysMemoryManager::FindVictim(AddrSpace *owner)
+{
+	TranslationEntry *entry;
+	int i, victim, pass;
+
+	ASSERT(owner->residentPages > 0);
+	owner->SyncTLB();
+	for (i = 0; i < TLBSize; i++)
+		if (machine->tlb[i].asid == owner->asid)
+			machine->tlb[i].use = false;
+	machine->FlushFastTranslations();	// the fast path skips setting
+						// use bits that are already set
+
+	switch (policy) {
+	  case ReplaceFIFO:
+		for (;;) {
+			victim = hand;
+			hand = (hand + 1) % NumPhysPages;
+			if (Maps(owner, victim))
+				return victim;
+		}
+
+	  case ReplaceClock:
+		for (;;) {
+			victim = hand;
+			hand = (hand + 1) % NumPhysPages;
+			if (!Maps(owner, victim))
+				continue;
+			entry = Entry(owner, victim);
+			if (!entry->use)
+				return victim;
+			entry->use = false;	// second chance
+		}
+
+	  case ReplaceEnhancedClock:
+		// look for (unused, clean), then (unused, dirty) while 
+		// clearing use bits, then the same again
+		for (pass = 0; ; pass++) {
+			for (i = 0; i < NumPhysPages; i++) {
+				victim = hand;
+				hand = (hand + 1) % NumPhysPages;
+				if (!Maps(owner, victim))
+					continue;
+				entry = Entry(owner, victim);
+				if (!entry->use && (entry->dirty == (pass % 2 == 1)))
+					return victim;
+				if (pass % 2 == 1)
+					entry->use = false;
+			}
+		}
+
+	  case ReplaceLRU:
+		victim = -1;
+		for (i = 0; i < NumPhysPages; i++) {
+			if (!Maps(owner, i))
+				continue;
+			entry = Entry(owner, i);
+			age[i] = (age[i] >> 1) | (entry->use ? 0x80 : 0);
+			entry->use = false;
+			if (victim == -1 || age[i] < age[victim])
+				victim = i;
+		}
+		return victim;
+	}
+	ASSERT(FALSE);
+	return -1;
+}
+
+//----------------------------------------------------------------------
+// PhysMemoryManager::Unmap
+// 	Take "frame" away from "space", which maps it, writing the page
+//	to swap first if it is dirty and "save" is set (cf. SavePage).  
+//	The frame is freed once no other space maps it.
+//
+//	The page table is updated before any I/O, since writing the
+//	page may block on the disk and let another thread fault in the
+//	meantime; the frame is freed only after it.
+//----------------------------------------------------------------------
+
+void
+PhysMemoryManager::Unmap(int frame, AddrSpace *space, bool save)
+{
+	int vpn = vpnArr[frame];
+	int i;
+
+	DEBUG('a', "Unmapping page %d from frame %d\n", vpn, frame);
+
+	//set space->vpn entry to unvalid; the TLB may map it too (even
+	//if space is not running), and may know that it is dirty
+	TranslationEntry *set = machine->TLBSet(vpn);
+	for (i = 0; i < TLBWays; i++)
+		if (set[i].valid && set[i].virtualPage == vpn && 
+		    set[i].asid == space->asid) {
+			space->pageTable[vpn].dirty |= set[i].dirty;
+			set[i].valid = false;
+		}
+	if (space == currentThread->space)
+		machine->FlushFastTranslations();
+	space->pageTable[vpn].valid = false;
+	space->residentPages--;
+
+	//copy data to swap, if it was modified
+	if (save)
+		space->SavePage(vpn, machine->mainMemory + frame*PageSize);
+	Drop(frame, space);
+}
+
+//----------------------------------------------------------------------
+// PhysMemoryManager::Drop
+// 	"space" no longer maps "frame".  Put the frame on the free list
+//	if no other space maps it either; otherwise, make sure it belongs
+//	to one that does.
+//----------------------------------------------------------------------
+
+void
+PhysMemoryManager::Drop(int frame, AddrSpace *space)
+{
+	if (--refCount[frame] == 0) {
+		Uncache(frame);
+		useArr[frame] = false;
+		spaceArr[frame] = NULL;
+		freeFrames[numFree++] = frame;
+		return;
+	}
+	if (spaceArr[frame] != space)
+		return;
+	for (int i = 0; i < NumASIDs; i++)
+		if (asidTable[i] != NULL && asidTable[i] != space && 
+		    Maps(asidTable[i], frame)) {
+			spaceArr[frame] = asidTable[i];
+			return;
+		}
+	ASSERT(FALSE);			// refCount is wrong
+}
+
+//----------------------------------------------------------------------
+// PhysMemoryManager::Hash
+// 	Return the bucket of the page cache for code page "vpn" of the
+//	program "program" (cf. AddrSpace::ProgramId).
+//----------------------------------------------------------------------
+
+int
+PhysMemoryManager::Hash(int program, int vpn)
+{
+	return (unsigned int) (program * 31 + vpn) % NumPhysPages;
+}
+
+//----------------------------------------------------------------------
+// PhysMemoryManager::Lookup
+// 	Return the frame that holds code page "vpn" of "program", if some
+//	process running the program has it in memory; -1 otherwise.
+//----------------------------------------------------------------------
+
+int
+PhysMemoryManager::Lookup(int program, int vpn)
+{
+	int frame;
+
+	for (frame = cacheBucket[Hash(program, vpn)]; frame != -1; 
+	    frame = cacheNext[frame])
+		if (cacheProgram[frame] == program && vpnArr[frame] == vpn)
+			return frame;
+	return -1;
+}
+
+//----------------------------------------------------------------------
+// PhysMemoryManager::CachePage
+// 	"frame" has just been loaded with virtual page "vpn" of "space".
+//	If the page holds only code, enter it in the page cache, so that
+//	other processes running the same program map this frame rather
+//	than load their own copy (cf. AllocFrame) -- unless another one
+//	loaded the page at the same time, and entered its frame first.
+//----------------------------------------------------------------------
+
+void
+PhysMemoryManager::CachePage(AddrSpace *space, int vpn, int frame)
+{
+	int program, bucket;
+
+	if (!space->IsCodePage(vpn))
+		return;
+	program = space->ProgramId();
+	if (Lookup(program, vpn) != -1)
+		return;
+	bucket = Hash(program, vpn);
+	cacheProgram[frame] = program;
+	cacheNext[frame] = cacheBucket[bucket];
+	cacheBucket[bucket] = frame;
+}
+
+//----------------------------------------------------------------------
+// PhysMemoryManager::Uncache
+// 	"frame" is being freed; if it is in the page cache, take it out.
+//----------------------------------------------------------------------
+
+void
+PhysMemoryManager::Uncache(int frame)
+{
+	int *link;
+
+	if (cacheProgram[frame] == -1)
+		return;
+	for (link = &cacheBucket[Hash(cacheProgram[frame], vpnArr[frame])];
+	    *link != frame; link = &cacheNext[*link])
+		ASSERT(*link != -1);
+	*link = cacheNext[frame];
+	cacheProgram[frame] = cacheNext[frame] = -1;
+}
+
+//----------------------------------------------------------------------
+// PhysMemoryManager::Admit
+// 	Give a quota to "space", which has none: it is new, or was
+//	suspended.  Wait until the quota it wants fits in memory, unless
+//	no other process holds any memory.
+//----------------------------------------------------------------------
+
+void
+PhysMemoryManager::Admit(AddrSpace *space)
+{
+	int grant;
+
+	memoryLock->Acquire();
+	while (totalQuota > 0 && totalQuota + space->wantedQuota > NumPhysPages)
+		memoryFree->Wait(memoryLock);
+	grant = min(space->wantedQuota, NumPhysPages - totalQuota);
+	space->frameQuota = grant;
+	totalQuota += grant;
+	space->suspended = false;
+	DEBUG('a', "Admitted address space with quota %d\n", grant);
+	memoryLock->Release();
+}
+
+//----------------------------------------------------------------------
+// PhysMemoryManager::Suspend
+// 	Swap out every page of "space" (which is not running), and take
+//	away its quota; it asks for the same quota again at its next page
+//	fault (cf. Admit).
+//
+//	The quota is only given back once the frames are free: Unmap may
+//	wait for the swap file, and meanwhile no one else may count on
+//	the frames.
+//----------------------------------------------------------------------
+
+void
+PhysMemoryManager::Suspend(AddrSpace *space)
+{
+	int quota = space->frameQuota;
+
+	DEBUG('a', "Suspending address space with quota %d\n", quota);
+	space->wantedQuota = quota;
+	space->frameQuota = 0;
+	space->suspended = true;
+	stats->numSuspensions++;
+	for (int i = 0; i < NumPhysPages; i++)
+		if (Maps(space, i))
+			Unmap(i, space, TRUE);
+	totalQuota -= quota;
+}
+
+//----------------------------------------------------------------------
+// PhysMemoryManager::AdjustQuota
+// 	"space" has taken a page fault; grow or shrink its quota by its
+//	page fault frequency.  If it needs to grow and memory is full,
+//	suspend the other process with the largest quota to make room.
+//----------------------------------------------------------------------
+
+void
+PhysMemoryManager::AdjustQuota(AddrSpace *space)
+{
+	int interval = stats->userTicks - space->lastFaultTick;
+	AddrSpace *other = NULL;
+	int i;
+
+	if (interval < PFFGrowTicks && space->frameQuota < (int) space->numPages) {
+		if (totalQuota == NumPhysPages) {
+			for (i = 0; i < NumPhysPages; i++)
+				if (useArr[i] && spaceArr[i] != space && 
+				    (other == NULL || 
+				    spaceArr[i]->frameQuota > other->frameQuota))
+					other = spaceArr[i];
+			if (other != NULL && other->frameQuota > 0)
+				Suspend(other);
+		}
+		if (totalQuota < NumPhysPages) {
+			space->frameQuota++;
+			totalQuota++;
+		}
+	} else if (interval > PFFShrinkTicks && space->frameQuota > MinFrameQuota) {
+		space->frameQuota--;
+		while (space->residentPages > space->frameQuota)
+			Unmap(FindVictim(space), space, TRUE);
+		totalQuota--;		// only now that the frame is free
+		memoryLock->Acquire();
+		memoryFree->Broadcast(memoryLock);
+		memoryLock->Release();
+	}
+}
+
+//----------------------------------------------------------------------
+// PhysMemoryManager::AllocFrame
+// 	Find a frame for virtual page "vpn" of "space", the running 
+//	process, which has just faulted on it: a free one, after evicting
+//	one of its own pages if the process is at its quota.  A space
+//	forked since its last fault may be over its quota, as the pages
+//	it shares count against it too; it evicts pages until it is not.
+//
+//	A code page that another process running the same program has in
+//	memory is not loaded again: its frame is shared, and the caller
+//	can tell by its reference count.
+//
+//	Returns the frame, which the caller must fill.
+//----------------------------------------------------------------------
+
+int
+PhysMemoryManager::AllocFrame(AddrSpace *space, int vpn)
+{
+	space->numFaults++;
+	stats->processPageFaults[space->asid]++;
+	if (space->frameQuota == 0)
+		Admit(space);
+	else
+		AdjustQuota(space);
+	space->lastFaultTick = stats->userTicks;
+	return TakeFrame(space, vpn);
+}
+
+//----------------------------------------------------------------------
+// PhysMemoryManager::TakeFrame
+// 	The part of AllocFrame that finds the frame, within the quota
+//	"space" already has.  Unshare uses it directly, as copying a page
+//	is not a page fault, and should not count as one or change the
+//	quota.
+//
+//	Evicting a page may wait for the swap file, and meanwhile another
+//	process may suspend "space"; it is then admitted again before 
+//	taking a frame.
+//----------------------------------------------------------------------
+
+int
+PhysMemoryManager::TakeFrame(AddrSpace *space, int vpn)
+{
+	int frame;
+
+	for (;;) {
+		if (space->frameQuota == 0)	// suspended
+			Admit(space);
+		if (space->residentPages < space->frameQuota)
+			break;
+		Unmap(FindVictim(space), space, TRUE);
+	}
+
+	if (space->IsCodePage(vpn)) {
+		frame = Lookup(space->ProgramId(), vpn);
+		if (frame != -1) {
+			refCount[frame]++;
+			space->residentPages++;
+			stats->numCodeShares++;
+			return frame;
+		}
+	}
+	ASSERT(numFree > 0);	// the quotas fit in memory
+	frame = freeFrames[--numFree];
+	useArr[frame] = true;
+	spaceArr[frame] = space;
+	vpnArr[frame] = vpn;
+	refCount[frame] = 1;
+	age[frame] = 0;
+	space->residentPages++;
+	return frame;
+}
+
+//----------------------------------------------------------------------
+// PhysMemoryManager::Release
+// 	"space" is being deleted: put the frames only it maps back on the
+//	free list, and give back its quota to the processes waiting for 
+//	memory.
+//----------------------------------------------------------------------
+
+void
+PhysMemoryManager::Release(AddrSpace *space)
+{
+	for (int i = 0; i < NumPhysPages; i++)
+		if (Maps(space, i))
+			Drop(i, space);
+	space->residentPages = 0;
+	totalQuota -= space->frameQuota;
+	space->frameQuota = 0;
+	memoryLock->Acquire();
+	memoryFree->Broadcast(memoryLock);
+	memoryLock->Release();
+}
+
+//----------------------------------------------------------------------
+// PhysMemoryManager::Unshare
+// 	Virtual page "vpn" of "space", the running process, is about to
+//	be written, and may share its frame with other processes (cf. 
+//	AddrSpace::CopyOnWrite).  If it does, copy the page to a new
+//	frame of its own; the copy is dirty, as it is in neither swap nor
+//	the program.  Either way, drop the read-only translation from 
+//	the TLB.
+//----------------------------------------------------------------------
+
+void
+PhysMemoryManager::Unshare(AddrSpace *space, int vpn)
+{
+	TranslationEntry *entry = &space->pageTable[vpn];
+	int frame = entry->physicalPage;
+	char page[PageSize];
+
+	if (refCount[frame] == 1) {
+		TranslationEntry *set = machine->TLBSet(vpn);
+		for (int i = 0; i < TLBWays; i++)
+			if (set[i].valid && set[i].virtualPage == vpn &&
+			    set[i].asid == space->asid) {
+				entry->use |= set[i].use;
+				set[i].valid = false;
+			}
+		machine->FlushFastTranslations();
+		return;
+	}
+
+	DEBUG('a', "Copying shared page %d out of frame %d\n", vpn, frame);
+	memcpy(page, machine->mainMemory + frame*PageSize, PageSize);
+	Unmap(frame, space, FALSE);	// the frame still holds the page
+					// for the others
+	frame = TakeFrame(space, vpn);
+	memcpy(machine->mainMemory + frame*PageSize, page, PageSize);
+	machine->InvalidateFrameDecoded(frame);
+	entry->physicalPage = frame;
+	entry->use = entry->dirty = true;
+	entry->valid = true;
+}
+
+//----------------------------------------------------------------------
+// PhysMemoryManager::KeepFrame
+// 	"frame" has just been filled with a page of "space", which faulted
+//	on it.  Filling it may have waited for the disk, and meanwhile 
+//	another process may have suspended "space": Suspend only takes
+//	the pages that are mapped, so the frame would be left to a space
+//	with no quota to count it against.  In that case free the frame 
+//	(the page is clean: its swap slot or the executable still holds
+//	it), and return FALSE, so that the caller takes the fault again.
+//----------------------------------------------------------------------
+
+bool
+PhysMemoryManager::KeepFrame(AddrSpace *space, int frame)
+{
+	if (space->frameQuota > 0)
+		return TRUE;
+	DEBUG('a', "Suspended while loading into frame %d\n", frame);
+	Unmap(frame, space, FALSE);
+	return FALSE;
+}
+
 //get translationEntry from pageTable, 
 //if the page data is not in physmemory, load from disk
 TranslationEntry* getTranslationEntry(int vpn) {
-	if (currentThread->space->pageTable[vpn].valid) 
-		return &currentThread->space->pageTable[vpn];
-	
 	AddrSpace *currentSpace = currentThread->space;
+	int k;
 
-	int i, k;
-	double mx = 1e30;
-	for (int i = 0; i < NumPhysPages; i++) {
-		if (physMemoryManager->useArr[i] == false) {
-			physMemoryManager->useArr[i] = true;
-			physMemoryManager->lastUseTick[i] = stats->totalTicks;
-			physMemoryManager->spaceArr[i] = currentSpace;
-			physMemoryManager->vpnArr[i] = vpn;
-			
-			currentSpace->pageTable[vpn].physicalPage = i;
-			currentSpace->pageTable[vpn].valid = true;
-			
-			memcpy(machine->mainMemory + i*PageSize, currentSpace->virDisk + vpn*PageSize, PageSize);
-			return &currentSpace->pageTable[vpn];
-		} else {
-			if (physMemoryManager->lastUseTick[i] < mx) {
-				mx = physMemoryManager->lastUseTick[i];
-				k = i;
-			}
-		}
-	}
-	AddrSpace *anSpace = physMemoryManager->spaceArr[k];
-	int anVpn = physMemoryManager->vpnArr[k];
+	if (currentSpace->pageTable[vpn].valid) 
+		return &currentSpace->pageTable[vpn];
 
-	//set anSpace->anVpn entry to unvalid
-	//copy data to disk
-	memcpy(anSpace->virDisk + anVpn*PageSize, machine->mainMemory + k*PageSize, PageSize);
-	anSpace->pageTable[anVpn].valid = false;
-	
-	//copy data from currentSpace->disk to memory
-	memcpy(machine->mainMemory + k*PageSize, currentSpace->virDisk + vpn*PageSize, PageSize);
-	currentSpace->pageTable[vpn].physicalPage = k;
+	stats->numPageFaults++;
+	do {
+		k = physMemoryManager->AllocFrame(currentSpace, vpn);
+
+		//copy data from currentSpace's executable or swap to memory
+		currentSpace->pageTable[vpn].physicalPage = k;
+		currentSpace->pageTable[vpn].use = true;
+		if (physMemoryManager->refCount[k] == 1) {	// not shared
+			currentSpace->LoadPage(vpn, 
+				machine->mainMemory + k*PageSize);
+			machine->InvalidateFrameDecoded(k);
+			physMemoryManager->CachePage(currentSpace, vpn, k);
+		}
+	} while (!physMemoryManager->KeepFrame(currentSpace, k));
 	currentSpace->pageTable[vpn].valid = true;
-	//set values in physMemory
-	physMemoryManager->useArr[k] = true;
-	physMemoryManager->lastUseTick[k] = stats->totalTicks;
-	physMemoryManager->spaceArr[k] = currentSpace;
-	physMemoryManager->vpnArr[k] = vpn;
 	
 	return &currentSpace->pageTable[vpn];
 }
 bool Machine::tlbMiss_LRU(int vpn) {
-<<<<<<< HEAD
-=======
-printf("tlbMiss\n");
->>>>>>> e1161f913130ed97fdc5d8bf7b9d50d8f26f1799
-	TranslationEntry *entry = getTranslationEntry(vpn);
-
-	for (int i = 0; i < TLBSize; i++) {
-		if (tlb[i].valid == false) {	
-			memcpy(&tlb[i], &currentThread->space->pageTable[vpn], sizeof(TranslationEntry)); 
-			tlb[i].use = true;
-			tlb[i].lastUseTick = stats->totalTicks;
-			return true;
-		}
-	}
+	getTranslationEntry(vpn);
 
-	float mx = 1e30;
-	int k = -1;
-	for (int i = 0; i < TLBSize; i++) {
-		if (tlb[i].lastUseTick < mx) {
-			mx = tlb[i].lastUseTick;
+	// only one set can hold vpn: take a free entry of it, or the one
+	// used longest ago
+	TranslationEntry *set = TLBSet(vpn);
+	int k = 0;
+	for (int i = 0; i < TLBWays; i++) {
+		if (set[i].valid == false) {
 			k = i;
+			break;
 		}
+		if (set[i].lastUseTick < set[k].lastUseTick)
+			k = i;
 	}
-	memcpy(&tlb[k], &currentThread->space->pageTable[vpn], sizeof(TranslationEntry)); 
-	tlb[k].use = true;
-	tlb[k].lastUseTick = stats->totalTicks;
+	WriteBackTLBEntry(&set[k]);	// keep the victim's dirty bit
+	memcpy(&set[k], &currentThread->space->pageTable[vpn], sizeof(TranslationEntry)); 
+	set[k].use = true;
+	set[k].lastUseTick = stats->totalTicks;
 	return true;
 }
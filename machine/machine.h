@@ -26,6 +26,7 @@
 #include "translate.h"
 #include "disk.h"
 #include "addrspace.h"
+#include "stats.h"
 
 // Definitions related to the size, and format of user memory
 
@@ -33,10 +34,28 @@
 					// the disk sector size, for
 					// simplicity
 
-#define NumPhysPages    32
+// The number of page frames, the number of TLB entries, and the largest
+// number of pages in an address space can be set when Nachos starts
+// (cf. Initialize); these are the defaults.
+
+#define DefaultNumPhysPages	32
+#define DefaultTLBSize		4	// if there is a TLB, make it small
+#define DefaultNumVirPages	64
+
+extern int numPhysPages, tlbSize, tlbWays, numVirPages;	// cf. system.cc
+
+#define NumPhysPages    numPhysPages
 #define MemorySize 	(NumPhysPages * PageSize)
-#define TLBSize		4		// if there is a TLB, make it small
-#define NumVirPages 64
+#define TLBSize		tlbSize
+#define TLBWays		tlbWays		// entries per set; TLBSize makes
+					// the TLB fully associative
+#define TLBSets		(TLBSize / TLBWays)
+#define NumVirPages 	numVirPages
+
+#define NumASIDs	MaxProcessStats	// address space identifiers
+
+#define DecodeCacheSize	(MemorySize / 4)	// one decoded instruction
+						// per word of physical memory
 
 enum ExceptionType { NoException,           // Everything ok!
 		     SyscallException,      // A program executed a system call.
@@ -74,19 +93,134 @@ enum ExceptionType { NoException,           // Everything ok!
 #define NumTotalRegs 	40
 
 
+// The following class defines the frame table: which virtual page of
+// which address space is in each page frame of main memory.  
+//
+// Each address space may hold up to its quota of frames; it is given
+// free frames until it reaches its quota, after which it replaces its
+// own pages (local replacement), choosing a victim by one of the 
+// policies below, using the use and dirty bits of the page table
+// entries (cf. AddrSpace::SyncTLB).
+//
+// Quotas follow each process's page fault frequency: a process that
+// faults again within PFFGrowTicks user instructions gets one more
+// frame, and one that goes PFFShrinkTicks without faulting gives one
+// back.  The quotas never add up to more than NumPhysPages.  When a
+// process needs to grow and memory is full, another process is 
+// suspended instead: all of its pages are swapped out, and it waits at
+// its next page fault until its old quota fits in memory again.
+
+#define MinFrameQuota		2	// frames a process always keeps
+#define InitialFrameQuota	4	// frames a new process starts with
+#define PFFGrowTicks		200	// fault interval (user instructions)
+					// below which the quota grows
+#define PFFShrinkTicks		4000	// ... and above which it shrinks
+
+class Lock;
+class Condition;
+
+enum ReplacementPolicy {
+    ReplaceFIFO,		// the frame loaded longest ago
+    ReplaceClock,		// second chance, using the use bit
+    ReplaceEnhancedClock,	// second chance, preferring clean pages
+    ReplaceLRU			// approximate LRU, by aging the use bits
+};
+
 class PhysMemoryManager{
 public:
-	bool useArr[NumPhysPages];
-	AddrSpace* spaceArr[NumPhysPages];
-	int vpnArr[NumPhysPages];
-	int lastUseTick[NumPhysPages];
-	PhysMemoryManager() {
-		int i;
-		for (i = 0; i < NumPhysPages; i++) useArr[i] = false;
-	}
+	PhysMemoryManager(ReplacementPolicy replacement = ReplaceClock);
+
+	int AllocFrame(AddrSpace *space, int vpn);
+				// Give a frame to virtual page "vpn" of
+				// "space", evicting another page if need be
+	void Release(AddrSpace *space);	// "space" is being deleted; take
+				// back its frames and its quota
+	void Unshare(AddrSpace *space, int vpn);	// give "vpn" of
+				// "space" a frame no one else maps
+	void CachePage(AddrSpace *space, int vpn, int frame);
+				// "frame", just loaded, holds "vpn" of 
+				// "space"; share it if it is code
+	bool KeepFrame(AddrSpace *space, int frame);
+				// may "space" map "frame", now that it 
+				// is loaded? if not, the frame is freed
+
+	~PhysMemoryManager();
+
+	bool *useArr;		// is the frame in use?
+	AddrSpace **spaceArr;	// if so, whose page is in it,
+	int *vpnArr;		// and which page
+	int *refCount;		// how many address spaces map it (a
+				// forked child shares its parent's
+				// frames at the same virtual pages)
+
+private:
+	TranslationEntry *Entry(AddrSpace *space, int frame);
+				// page table entry of "space" for the
+				// page in "frame"
+	int TakeFrame(AddrSpace *space, int vpn);	// AllocFrame,
+				// without counting a page fault
+	int FindVictim(AddrSpace *owner);	// choose one of owner's
+				// frames to evict
+	bool Maps(AddrSpace *space, int frame);	// does "space" have
+				// "frame" in its page table?
+	void Unmap(int frame, AddrSpace *space, bool save);
+				// take "frame" from "space", writing the
+				// page to swap first if "save"
+	void Drop(int frame, AddrSpace *space);	// "space" no longer
+				// maps "frame"; free it if no one does
+	int Lookup(int program, int vpn);	// frame holding code page
+				// "vpn" of "program", or -1
+	int Hash(int program, int vpn);		// its bucket
+	void Uncache(int frame);	// take "frame" out of the page cache
+	void Admit(AddrSpace *space);	// wait until "space" can be given
+				// a quota
+	void AdjustQuota(AddrSpace *space);	// grow or shrink the quota
+				// of "space", which just faulted
+	void Suspend(AddrSpace *space);	// take all frames of "space"
+
+	ReplacementPolicy policy;
+	int totalQuota;		// sum of the quotas of all processes
+	Lock *memoryLock;	// protects waiting for memory
+	Condition *memoryFree;	// signalled when quota is given back
+	int *freeFrames;	// stack of unused frames
+	int numFree;
+	int hand;		// the clock hand: next frame to consider
+	unsigned char *age;	// use bits sampled at each
+				// fault, most recent in the high bit (LRU)
+
+	// the page cache: frames holding code pages, which any process
+	// running the same program can map, by (program, virtual page)
+	int *cacheProgram;	// the program of the code page in the
+				// frame, or -1 if the frame is not cached
+	int *cacheNext;		// next frame in the same bucket, or -1
+	int *cacheBucket;	// first frame in each bucket, or -1
 };
 
 
+// The following class defines an entry in the simulator's own cache of
+// recent address translations.  It is not part of the simulated 
+// hardware: it only remembers what Machine::Translate concluded last
+// time for a virtual page, so that later references to the page can
+// skip the TLB (or page table) lookup.  An entry is installed only 
+// once the use bit (and, for "writable", the dirty bit) of the real
+// translation is already set, so skipping Translate changes nothing
+// the kernel can see.  The one thing that changes on every reference
+// is a TLB entry's lastUseTick, which the LRU TLB replacement needs, so
+// a hit keeps that up to date itself.  All entries are dropped whenever
+// the kernel might have changed the TLB or page table (cf. 
+// FlushFastTranslations).
+
+#define FastXlateSize	64	// entries, direct-mapped by vpn
+
+class FastTranslation {
+  public:
+    int vpn;			// virtual page cached here, -1 if none
+    int frameAddr;		// physical address of the page frame
+    bool writable;		// can stores use this entry too?
+    TranslationEntry *tlbEntry;	// the TLB entry it came from, or NULL
+				// if there is no TLB
+};
+
 // The following class defines an instruction, represented in both
 // 	undecoded binary form
 //      decoded to identify
@@ -107,6 +241,57 @@ class Instruction {
                      // Immediates are sign-extended.
 };
 
+// User code can also be run a basic block at a time (cf. Machine::RunBlock):
+// a straight-line run of instructions, ending after the delay slot of
+// the first branch or jump, at a syscall, or at the end of the page.
+// Blocks never cross a page boundary, so a block is named by the
+// physical address of its first instruction.
+//
+// A block is translated once into an array of micro-ops: decoded
+// instructions, with what can be worked out from the code alone done
+// ahead of time.  Branch targets are made relative to the start of the
+// block, and the branch and its delay slot are run in order, with the
+// new PC installed once at the end of the block.  Each load is marked
+// either "direct", if the next instruction does not touch its target
+// register, in which case it writes the register at once, or
+// "delayed", in which case it goes through LoadReg/LoadValueReg, and
+// only the instruction after it commits the load.  Instructions that
+// are not worth translating are run by Machine::Execute ("generic").
+
+#define MicroGeneric	0x1	// run through Machine::Execute
+#define MicroDelayLoad	0x2	// a load whose value waits for the next
+				// instruction to complete
+#define MicroCommitLoad	0x4	// complete any pending delayed load after
+				// this instruction
+#define MicroDirectLoad	0x8	// a load that can write its register
+				// at once
+
+class MicroOp {
+  public:
+    char opCode;		// as in Instruction
+    char rs, rt, rd;
+    char flags;			// Micro... flags above
+    int extra;			// as in Instruction, except that for
+				// translated branches, the target's 
+				// offset from the start of the block
+};
+
+class Block {
+  public:
+    ~Block() { delete [] ops; }
+
+    int length;			// number of micro-ops
+    int branch;			// index of the branch or jump ending the
+				// block, or -1 if there is none
+    MicroOp *ops;		// the translated instructions
+    int users;			// threads running the block right now
+    bool dropped;		// forgotten while in use: delete once the
+				// last user is done with it
+};
+
+extern Statistics *stats;	// for the ticks in FastTranslate; defined
+				// in system.cc
+
 // The following class defines the simulated host workstation hardware, as 
 // seen by user programs -- the CPU registers, main memory, etc.
 // User programs shouldn't be able to tell that they are running on our 
@@ -122,7 +307,8 @@ class Instruction {
 
 class Machine {
   public:
-    Machine(bool debug);	// Initialize the simulation of the hardware
+    Machine(bool debug, bool blocks = FALSE);
+				// Initialize the simulation of the hardware
 				// for running user programs
     ~Machine();			// De-allocate the data structures
 
@@ -139,6 +325,13 @@ class Machine {
 
     void OneInstruction(Instruction *instr); 	
     				// Run one instruction of a user program.
+    int RunBlock();		// Run the basic block at the PC; returns
+				// the number of ticks to charge for it
+    bool Execute(Instruction *instr);
+				// Execute a fetched instruction; returns
+				// FALSE if it raised an exception
+    Instruction *Decoded(int physAddr);
+				// The decoded instruction at "physAddr"
     void DelayedLoad(int nextReg, int nextVal);  	
 				// Do a pending delayed load (modifying a reg)
     
@@ -155,6 +348,26 @@ class Machine {
     				// and return an exception code if the 
 				// translation couldn't be completed.
 
+    bool FastTranslate(int virtAddr, int size, bool writing, int* physAddr) {
+	FastTranslation *fast = 
+		&fastXlate[((unsigned) virtAddr / PageSize) % FastXlateSize];
+	if (fast->vpn != (int) ((unsigned) virtAddr / PageSize) 
+		|| (virtAddr & (size - 1)) || (writing && !fast->writable))
+	    return FALSE;
+	if (fast->tlbEntry != NULL)
+	    fast->tlbEntry->lastUseTick = stats->totalTicks;
+	*physAddr = fast->frameAddr + (unsigned) virtAddr % PageSize;
+	return TRUE;
+    }
+				// Translate using the simulator's cache
+				// of recent translations, if possible;
+				// returns FALSE if Translate is needed.
+
+    void FlushFastTranslations();	// Forget all cached translations;
+				// must be called after any change to the
+				// TLB or page table.  RaiseException and
+				// AddrSpace::RestoreState do it.
+
     void RaiseException(ExceptionType which, int badVAddr);
 				// Trap to the Nachos kernel, because of a
 				// system call or other exception.  
@@ -198,17 +411,58 @@ class Machine {
     TranslationEntry *pageTable;
     unsigned int pageTableSize;
 
+// TLB entries are tagged with the address space identifier of their
+// process, and only those of the running process match, so the kernel
+// need not flush the TLB on a context switch.  The TLB is set-associative:
+// virtual page "vpn" can only be in set vpn % TLBSets.
+
+    int currentASID;		// identifier of the running address space
+
+    TranslationEntry *TLBSet(int vpn) { return &tlb[(vpn % TLBSets) * TLBWays]; }
+				// the TLB entries that may hold "vpn"
+
 	bool tlbMiss_FIFO2(int vpn); //add in lab5 for tlbmiss
 	bool tlbMiss_LRU(int vpn);   //add in lab5 for tlbmiss
 
+    void InvalidateDecoded(int physAddr);	// a word of physical memory
+					// was written; forget its decoding
+    void InvalidateFrameDecoded(int frame);	// the same, for a whole
+					// page frame (page loaded or evicted)
+
   private:
+    Block *FormBlock(int physAddr);	// translate the block starting
+					// at physAddr
+    int ExecuteBlock(Block *block, int start);
+					// run a block, at virtual address
+					// "start"; returns the number of
+					// instructions run
+    void SetBlockPC(Block *block, int start, int which, int target);
+					// Set the PCs as they are before
+					// instruction "which" of a block
+    void DropBlock(Block *block);	// forget a translated block
+    void ReleaseBlock();		// done with runningBlock
+
+    bool blockMode;		// run user code a basic block at a time
     bool singleStep;		// drop back into the debugger after each
 				// simulated instruction
     int runUntilTime;		// drop back into the debugger when simulated
 				// time reaches this value
 
 	//add in lab5
-	int clockPos; // the clock posiont for FIFO(second chance)
+	int *clockPos; // the clock position of each TLB set, for
+		       // FIFO (second chance)
+
+    FastTranslation fastXlate[FastXlateSize];
+				// recent translations, by vpn % FastXlateSize
+
+    Instruction *decodeCache;	// decoded instructions, indexed by
+				// physical address / 4
+    bool *decodeValid;		// is decodeCache[i] up to date?
+    Block **blockTable;		// the translated block starting at each
+				// word, if any
+    bool *frameHasBlocks;	// is there any block in the frame?
+    Block *runningBlock;	// the block being run, until it ends or
+				// traps; NULL if none
 	
 };
 
@@ -18,11 +18,17 @@
 
 static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
 
+#define OP_NOP		0	// not a MIPS opcode: a translated instruction
+				// that does nothing (cf. Machine::FormBlock)
+
 //----------------------------------------------------------------------
 // Machine::Run
 // 	Simulate the execution of a user-level program on Nachos.
 //	Called by the kernel when the program starts up; never returns.
 //
+//	With "-bb", instructions are run a basic block at a time
+//	(cf. Machine::RunBlock), unless we are single-stepping or tracing.
+//
 //	This routine is re-entrant, in that it can be called multiple
 //	times concurrently -- one for each thread executing user code.
 //----------------------------------------------------------------------
@@ -37,8 +43,15 @@ Machine::Run()
 	       currentThread->getName(), stats->totalTicks);
     interrupt->setStatus(UserMode);
     for (;;) {
-		OneInstruction(instr);
-		interrupt->OneTick();
+	if (blockMode && !singleStep && !DebugIsEnabled('m')) {
+	    int count = RunBlock();
+	    stats->processTicks[currentASID] += count;
+	    interrupt->OneTick(count);
+	} else {
+	    OneInstruction(instr);
+	    stats->processTicks[currentASID]++;
+	    interrupt->OneTick();
+	}
 	if (singleStep && (runUntilTime <= stats->totalTicks))
 	  Debugger();
     }
@@ -79,6 +92,11 @@ TypeToReg(RegType reg, Instruction *instr)
 // 	the OS software must increment the PC so execution begins
 // 	at the instruction immediately after the syscall. 
 //
+//	Decoding is skipped if the instruction at this physical address
+//	has been decoded before and that memory has not been written
+//	since (cf. Machine::InvalidateDecoded); the decoded copy depends
+//	only on the contents of physical memory.
+//
 //	This routine is re-entrant, in that it can be called multiple
 //	times concurrently -- one for each thread executing user code.
 //	We get re-entrancy by never caching any data -- we always re-start the
@@ -93,16 +111,18 @@ TypeToReg(RegType reg, Instruction *instr)
 void
 Machine::OneInstruction(Instruction *instr)
 {
-    int raw;
-    int nextLoadReg = 0; 	
-    int nextLoadValue = 0; 	// record delayed load operation, to apply
-				// in the future
+    int physAddr;
+    ExceptionType exception;
 
     // Fetch instruction 
-    if (!machine->ReadMem(registers[PCReg], 4, &raw))
-	return;			// exception occurred
-    instr->value = raw;
-    instr->Decode();
+    if (!FastTranslate(registers[PCReg], 4, FALSE, &physAddr)) {
+	exception = Translate(registers[PCReg], &physAddr, 4, FALSE);
+	if (exception != NoException) {
+	    RaiseException(exception, registers[PCReg]);
+	    return;		// exception occurred
+	}
+    }
+    *instr = *Decoded(physAddr);
 
     if (DebugIsEnabled('m')) {
        struct OpString *str = &opStrings[instr->opCode];
@@ -114,6 +134,604 @@ Machine::OneInstruction(Instruction *instr)
        printf("\n");
        }
     
+    Execute(instr);
+}
+
+//----------------------------------------------------------------------
+// Machine::Decoded
+// 	Return the decoded form of the instruction word at physical
+//	address "physAddr", decoding it only if the word has been written
+//	since it was last decoded (cf. Machine::InvalidateDecoded).
+//----------------------------------------------------------------------
+
+Instruction *
+Machine::Decoded(int physAddr)
+{
+    Instruction *instr = &decodeCache[physAddr / 4];
+
+    if (decodeValid[physAddr / 4]) {
+	stats->numDecodeHits++;
+	return instr;
+    }
+    instr->value = WordToHost(*(unsigned int *) &mainMemory[physAddr]);
+    instr->Decode();
+    decodeValid[physAddr / 4] = TRUE;
+    stats->numDecodeMisses++;
+    return instr;
+}
+
+//----------------------------------------------------------------------
+// IsBranch
+// 	Does the operation transfer control (after its delay slot)?
+//----------------------------------------------------------------------
+
+static bool
+IsBranch(int opCode)
+{
+    switch (opCode) {
+      case OP_BEQ: case OP_BGEZ: case OP_BGEZAL: case OP_BGTZ:
+      case OP_BLEZ: case OP_BLTZ: case OP_BLTZAL: case OP_BNE:
+      case OP_J: case OP_JAL: case OP_JALR: case OP_JR:
+	return TRUE;
+      default:
+	return FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// EndsBlock
+// 	Does the operation always trap to the kernel?
+//----------------------------------------------------------------------
+
+static bool
+EndsBlock(int opCode)
+{
+    return opCode == OP_SYSCALL || opCode == OP_RES || opCode == OP_UNIMP;
+}
+
+//----------------------------------------------------------------------
+// IsTranslated
+// 	Does Machine::ExecuteBlock run the instruction itself, rather than
+//	through Machine::Execute?  Those left to Execute are the ones that
+//	can overflow, the rare ones, loads into R0, and OR (so that both
+//	ways of running it compute the same thing).
+//----------------------------------------------------------------------
+
+static bool
+IsTranslated(Instruction *instr)
+{
+    switch (instr->opCode) {
+      case OP_ADDIU: case OP_ADDU: case OP_AND: case OP_ANDI: 
+      case OP_NOR: case OP_ORI: case OP_XOR: case OP_XORI: case OP_LUI:
+      case OP_SLL: case OP_SLLV: case OP_SRA: case OP_SRAV: 
+      case OP_SRL: case OP_SRLV: case OP_SLT: case OP_SLTI: 
+      case OP_SLTIU: case OP_SLTU: case OP_SUBU:
+      case OP_MFHI: case OP_MFLO: case OP_MTHI: case OP_MTLO:
+      case OP_SB: case OP_SH: case OP_SW:
+	return TRUE;
+      case OP_LB: case OP_LBU: case OP_LH: case OP_LHU: case OP_LW:
+	return instr->rt != 0;
+      default:
+	return IsBranch(instr->opCode);
+    }
+}
+
+//----------------------------------------------------------------------
+// IsLoad
+// 	Does the instruction leave a delayed load pending?
+//----------------------------------------------------------------------
+
+static bool
+IsLoad(int opCode)
+{
+    switch (opCode) {
+      case OP_LB: case OP_LBU: case OP_LH: case OP_LHU: case OP_LW:
+      case OP_LWL: case OP_LWR:
+	return TRUE;
+      default:
+	return FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// Destination
+// 	The register written by a translated computational instruction,
+//	or -1 if there is none.
+//----------------------------------------------------------------------
+
+static int
+Destination(Instruction *instr)
+{
+    switch (instr->opCode) {
+      case OP_ADDU: case OP_AND: case OP_NOR: case OP_XOR:
+      case OP_SLL: case OP_SLLV: case OP_SRA: case OP_SRAV: 
+      case OP_SRL: case OP_SRLV: case OP_SLT: case OP_SLTU: case OP_SUBU:
+      case OP_MFHI: case OP_MFLO:
+	return instr->rd;
+      case OP_ADDIU: case OP_ANDI: case OP_ORI: case OP_XORI: case OP_LUI:
+      case OP_SLTI: case OP_SLTIU:
+	return instr->rt;
+      default:
+	return -1;
+    }
+}
+
+//----------------------------------------------------------------------
+// Uses
+// 	Might the instruction read or write register "reg"?  Errs on the
+//	side of yes, by looking at all of its register fields.
+//----------------------------------------------------------------------
+
+static bool
+Uses(Instruction *instr, int reg)
+{
+    switch (instr->opCode) {
+      case OP_BGEZAL: case OP_BLTZAL: case OP_JAL:
+	if (reg == R31)
+	    return TRUE;
+	break;
+    }
+    return instr->rs == reg || instr->rt == reg || instr->rd == reg;
+}
+
+//----------------------------------------------------------------------
+// Machine::FormBlock
+// 	Translate the basic block starting at physical address "physAddr"
+//	into micro-ops (cf. machine.h), and remember it.  The block ends
+//	after the delay slot of the first branch or jump, at a syscall or
+//	illegal instruction (which trap to the kernel), or at the end of
+//	the page, whichever comes first.
+//
+//	A branch whose delay slot holds another branch, or a trap, is left
+//	out, to start the next block; a block that starts with one is run
+//	through Machine::Execute instead.
+//----------------------------------------------------------------------
+
+Block *
+Machine::FormBlock(int physAddr)
+{
+    Instruction *code[PageSize / 4];
+    int start = physAddr / 4;
+    int end = (physAddr / PageSize + 1) * PageSize / 4;
+    int length = 0, branch = -1;
+    bool oddBranch = FALSE, pending = TRUE;
+    Block *block;
+    MicroOp *op;
+    int i;
+
+    while (start + length < end) {
+	code[length] = Decoded((start + length) * 4);
+	length++;
+	if (EndsBlock(code[length - 1]->opCode))
+	    break;
+	if (IsBranch(code[length - 1]->opCode)) {
+	    branch = length - 1;
+	    if (start + length < end) {	// the delay slot, if on this page
+		code[length] = Decoded((start + length) * 4);
+		length++;
+	    }
+	    break;
+	}
+    }
+    if (branch >= 0 && branch + 1 < length && 
+	    (IsBranch(code[branch + 1]->opCode) || 
+	     EndsBlock(code[branch + 1]->opCode))) {
+	oddBranch = (branch == 0);
+	length = oddBranch ? 1 : branch;
+	branch = -1;
+    }
+
+    block = new Block;
+    block->length = length;
+    block->branch = branch;
+    block->ops = new MicroOp[length];
+    block->users = 0;
+    block->dropped = FALSE;
+    for (i = 0; i < length; i++) {
+	op = &block->ops[i];
+	op->opCode = code[i]->opCode;
+	op->rs = code[i]->rs;
+	op->rt = code[i]->rt;
+	op->rd = code[i]->rd;
+	op->extra = code[i]->extra;
+	op->flags = 0;
+
+	if (oddBranch || !IsTranslated(code[i])) {
+	    op->flags = MicroGeneric;	// Execute completes any pending
+	    pending = IsLoad(op->opCode);	// load itself
+	    continue;
+	}
+	if (pending)			// the previous instruction was a
+	    op->flags |= MicroCommitLoad;	// delayed load (or unknown,
+					// at the start of the block)
+	if (IsLoad(op->opCode)) {
+	    if (pending || i + 1 == length || Uses(code[i + 1], op->rt))
+		op->flags |= MicroDelayLoad;
+	    else
+		op->flags |= MicroDirectLoad;
+	    pending = (op->flags & MicroDelayLoad) != 0;
+	    continue;
+	}
+	pending = FALSE;
+	if (Destination(code[i]) == 0)
+	    op->opCode = OP_NOP;	// writes R0, so has no effect
+	else if (op->opCode == OP_J || op->opCode == OP_JAL)
+	    op->extra = IndexToAddr(op->extra);
+	else if (IsBranch(op->opCode) && op->opCode != OP_JR 
+		 && op->opCode != OP_JALR)
+	    op->extra = i * 4 + 4 + IndexToAddr(op->extra);
+    }
+
+    blockTable[start] = block;
+    frameHasBlocks[physAddr / PageSize] = TRUE;
+    return block;
+}
+
+//----------------------------------------------------------------------
+// Machine::DropBlock
+// 	Forget a translated block.  If some thread is still in the middle
+//	of it, the last one out deletes it (cf. Machine::ReleaseBlock).
+//----------------------------------------------------------------------
+
+void
+Machine::DropBlock(Block *block)
+{
+    if (block->users > 0)
+	block->dropped = TRUE;
+    else
+	delete block;
+}
+
+//----------------------------------------------------------------------
+// Machine::RunBlock
+// 	Execute the basic block starting at the PC, without going back
+//	to Run (and the interrupt simulation) between its instructions.
+//	The block is translated the first time it is run.
+//
+//	Returns the number of instructions run (including one that
+//	trapped), i.e. the number of ticks to charge.
+//----------------------------------------------------------------------
+
+int
+Machine::RunBlock()
+{
+    int physAddr, count;
+    ExceptionType exception;
+    Block *block;
+
+    if (registers[NextPCReg] != registers[PCReg] + 4) {
+	Instruction instr;	// in a delay slot whose branch was the
+				// last instruction of the previous page
+	OneInstruction(&instr);
+	return 1;
+    }
+    if (!FastTranslate(registers[PCReg], 4, FALSE, &physAddr)) {
+	exception = Translate(registers[PCReg], &physAddr, 4, FALSE);
+	if (exception != NoException) {
+	    RaiseException(exception, registers[PCReg]);
+	    return 1;
+	}
+    }
+    block = blockTable[physAddr / 4];
+    if (block == NULL) {
+	block = FormBlock(physAddr);
+	stats->numBlockMisses++;
+    } else
+	stats->numBlockHits++;
+
+    block->users++;		// so that it survives being dropped while
+    runningBlock = block;	// we run it (e.g. by a store into its page)
+    count = ExecuteBlock(block, registers[PCReg]);
+    ReleaseBlock();
+    return count;
+}
+
+//----------------------------------------------------------------------
+// Machine::ReleaseBlock
+// 	Stop using runningBlock, deleting it if it was dropped meanwhile.
+//	Called at the end of RunBlock, and by RaiseException before the
+//	handler runs: the handler may switch to another thread, or
+//	finish this one, and once it has run the block is never touched
+//	again.  So at most one block is ever in use.
+//----------------------------------------------------------------------
+
+void
+Machine::ReleaseBlock()
+{
+    Block *block = runningBlock;
+
+    if (block == NULL)
+	return;				// released by a trap
+    runningBlock = NULL;
+    if (--block->users == 0 && block->dropped)
+	delete block;
+}
+
+//----------------------------------------------------------------------
+// Machine::SetBlockPC
+// 	Set the PC registers as they would be if the block had been run
+//	an instruction at a time, just before its instruction "which"
+//	(or just after the block, if "which" is its length).
+//
+//	"start" -- the virtual address of the block
+//	"target" -- where the block's branch goes, once it has been run
+//----------------------------------------------------------------------
+
+void
+Machine::SetBlockPC(Block *block, int start, int which, int target)
+{
+    int pc = start + which * 4;
+
+    registers[PrevPCReg] = pc - 4;
+    if (block->branch >= 0 && which == block->branch + 2)
+	pc = target;			// past the delay slot
+    registers[PCReg] = pc;
+    if (block->branch >= 0 && which == block->branch + 1)
+	registers[NextPCReg] = target;	// at the delay slot
+    else
+	registers[NextPCReg] = pc + 4;
+}
+
+//----------------------------------------------------------------------
+// Machine::ExecuteBlock
+// 	Run the micro-ops of a translated block, starting at virtual
+//	address "start".  The PC registers are only brought up to date
+//	before an instruction that may trap, and at the end.
+//
+//	Exceptions stay precise: if an instruction traps, the block stops
+//	there, with the earlier instructions of the block completed and
+//	the PC at the faulting one, just as if they had been run one at a
+//	time.  Once an instruction has trapped, the kernel may have
+//	changed anything, so the block is left at once.  The block is
+//	also left after a store that drops it (by writing into its page).
+//
+//	Returns the number of instructions run, including one that
+//	trapped.
+//----------------------------------------------------------------------
+
+int
+Machine::ExecuteBlock(Block *block, int start)
+{
+    int target = start + (block->branch + 2) * 4;	// if not taken
+    Instruction instr;
+    MicroOp *op;
+    int i, tmp, value = 0;
+
+    for (i = 0; i < block->length; i++) {
+	op = &block->ops[i];
+	if (op->flags & MicroGeneric) {
+	    SetBlockPC(block, start, i, target);
+	    instr.opCode = op->opCode;
+	    instr.rs = op->rs;
+	    instr.rt = op->rt;
+	    instr.rd = op->rd;
+	    instr.extra = op->extra;
+	    if (!Execute(&instr) || runningBlock == NULL	// trapped
+		    || block->dropped || i == block->length - 1)
+		return i + 1;		// Execute has set the PC
+	    continue;
+	}
+
+	switch (op->opCode) {
+	  case OP_NOP:
+	    break;
+
+	  case OP_ADDIU:
+	    registers[op->rt] = registers[op->rs] + op->extra;
+	    break;
+	  case OP_ADDU:
+	    registers[op->rd] = registers[op->rs] + registers[op->rt];
+	    break;
+	  case OP_AND:
+	    registers[op->rd] = registers[op->rs] & registers[op->rt];
+	    break;
+	  case OP_ANDI:
+	    registers[op->rt] = registers[op->rs] & (op->extra & 0xffff);
+	    break;
+	  case OP_NOR:
+	    registers[op->rd] = ~(registers[op->rs] | registers[op->rt]);
+	    break;
+	  case OP_ORI:
+	    registers[op->rt] = registers[op->rs] | (op->extra & 0xffff);
+	    break;
+	  case OP_XOR:
+	    registers[op->rd] = registers[op->rs] ^ registers[op->rt];
+	    break;
+	  case OP_XORI:
+	    registers[op->rt] = registers[op->rs] ^ (op->extra & 0xffff);
+	    break;
+	  case OP_LUI:
+	    registers[op->rt] = op->extra << 16;
+	    break;
+	  case OP_SLL:
+	    registers[op->rd] = registers[op->rt] << op->extra;
+	    break;
+	  case OP_SLLV:
+	    registers[op->rd] = registers[op->rt] << 
+		(registers[op->rs] & 0x1f);
+	    break;
+	  case OP_SRA:
+	    registers[op->rd] = registers[op->rt] >> op->extra;
+	    break;
+	  case OP_SRAV:
+	    registers[op->rd] = registers[op->rt] >> 
+		(registers[op->rs] & 0x1f);
+	    break;
+	  case OP_SRL:
+	    tmp = registers[op->rt];
+	    tmp >>= op->extra;
+	    registers[op->rd] = tmp;
+	    break;
+	  case OP_SRLV:
+	    tmp = registers[op->rt];
+	    tmp >>= (registers[op->rs] & 0x1f);
+	    registers[op->rd] = tmp;
+	    break;
+	  case OP_SLT:
+	    registers[op->rd] = registers[op->rs] < registers[op->rt];
+	    break;
+	  case OP_SLTI:
+	    registers[op->rt] = registers[op->rs] < op->extra;
+	    break;
+	  case OP_SLTIU:
+	    registers[op->rt] = (unsigned int) registers[op->rs] < 
+		(unsigned int) op->extra;
+	    break;
+	  case OP_SLTU:
+	    registers[op->rd] = (unsigned int) registers[op->rs] < 
+		(unsigned int) registers[op->rt];
+	    break;
+	  case OP_SUBU:
+	    registers[op->rd] = registers[op->rs] - registers[op->rt];
+	    break;
+	  case OP_MFHI:
+	    registers[op->rd] = registers[HiReg];
+	    break;
+	  case OP_MFLO:
+	    registers[op->rd] = registers[LoReg];
+	    break;
+	  case OP_MTHI:
+	    registers[HiReg] = registers[op->rs];
+	    break;
+	  case OP_MTLO:
+	    registers[LoReg] = registers[op->rs];
+	    break;
+
+	  // Branches only compute where the block goes after the delay
+	  // slot; "target" starts out as the fall-through address.
+	  case OP_BEQ:
+	    if (registers[op->rs] == registers[op->rt])
+		target = start + op->extra;
+	    break;
+	  case OP_BNE:
+	    if (registers[op->rs] != registers[op->rt])
+		target = start + op->extra;
+	    break;
+	  case OP_BGEZAL:
+	    registers[R31] = start + i * 4 + 8;
+	  case OP_BGEZ:
+	    if (!(registers[op->rs] & SIGN_BIT))
+		target = start + op->extra;
+	    break;
+	  case OP_BGTZ:
+	    if (registers[op->rs] > 0)
+		target = start + op->extra;
+	    break;
+	  case OP_BLEZ:
+	    if (registers[op->rs] <= 0)
+		target = start + op->extra;
+	    break;
+	  case OP_BLTZAL:
+	    registers[R31] = start + i * 4 + 8;
+	  case OP_BLTZ:
+	    if (registers[op->rs] & SIGN_BIT)
+		target = start + op->extra;
+	    break;
+	  case OP_JAL:
+	    registers[R31] = start + i * 4 + 8;
+	  case OP_J:
+	    target = ((start + i * 4 + 8) & 0xf0000000) | op->extra;
+	    break;
+	  case OP_JALR:
+	    registers[op->rd] = start + i * 4 + 8;
+	    registers[0] = 0;
+	  case OP_JR:
+	    target = registers[op->rs];
+	    break;
+
+	  case OP_LB:
+	  case OP_LBU:
+	    SetBlockPC(block, start, i, target);
+	    if (!ReadMem(registers[op->rs] + op->extra, 1, &value))
+		return i + 1;
+	    if ((value & 0x80) && (op->opCode == OP_LB))
+		value |= 0xffffff00;
+	    else
+		value &= 0xff;
+	    break;
+	  case OP_LH:
+	  case OP_LHU:
+	    tmp = registers[op->rs] + op->extra;
+	    SetBlockPC(block, start, i, target);
+	    if (tmp & 0x1) {
+		RaiseException(AddressErrorException, tmp);
+		return i + 1;
+	    }
+	    if (!ReadMem(tmp, 2, &value))
+		return i + 1;
+	    if ((value & 0x8000) && (op->opCode == OP_LH))
+		value |= 0xffff0000;
+	    else
+		value &= 0xffff;
+	    break;
+	  case OP_LW:
+	    tmp = registers[op->rs] + op->extra;
+	    SetBlockPC(block, start, i, target);
+	    if (tmp & 0x3) {
+		RaiseException(AddressErrorException, tmp);
+		return i + 1;
+	    }
+	    if (!ReadMem(tmp, 4, &value))
+		return i + 1;
+	    break;
+
+	  case OP_SB:
+	    SetBlockPC(block, start, i, target);
+	    if (!WriteMem((unsigned) (registers[op->rs] + op->extra), 1, 
+			  registers[op->rt]))
+		return i + 1;
+	    break;
+	  case OP_SH:
+	    SetBlockPC(block, start, i, target);
+	    if (!WriteMem((unsigned) (registers[op->rs] + op->extra), 2, 
+			  registers[op->rt]))
+		return i + 1;
+	    break;
+	  case OP_SW:
+	    SetBlockPC(block, start, i, target);
+	    if (!WriteMem((unsigned) (registers[op->rs] + op->extra), 4, 
+			  registers[op->rt]))
+		return i + 1;
+	    break;
+
+	  default:
+	    ASSERT(FALSE);
+	}
+
+	if (op->flags & MicroCommitLoad) {
+	    registers[registers[LoadReg]] = registers[LoadValueReg];
+	    registers[LoadReg] = 0;
+	    registers[0] = 0;
+	}
+	if (op->flags & MicroDelayLoad) {
+	    registers[LoadReg] = op->rt;
+	    registers[LoadValueReg] = value;
+	} else if (op->flags & MicroDirectLoad)
+	    registers[op->rt] = value;
+	if (block->dropped) {		// a store overwrote this page
+	    SetBlockPC(block, start, i + 1, target);
+	    return i + 1;
+	}
+    }
+    SetBlockPC(block, start, block->length, target);
+    return block->length;
+}
+
+//----------------------------------------------------------------------
+// Machine::Execute
+// 	Execute one (fetched and decoded) instruction, and advance the PC.
+//
+//	Returns FALSE if the instruction raised an exception, in which
+//	case the PC is left pointing at it.
+//----------------------------------------------------------------------
+
+bool
+Machine::Execute(Instruction *instr)
+{
+    int nextLoadReg = 0; 	
+    int nextLoadValue = 0; 	// record delayed load operation, to apply
+				// in the future
+
     // Compute next pc, but don't install in case there's an error or branch.
     int pcAfter = registers[NextPCReg] + 4;
     int sum, diff, tmp, value;
@@ -127,7 +745,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (!((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
 	    ((registers[instr->rs] ^ sum) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rd] = sum;
 	break;
@@ -137,7 +755,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (!((registers[instr->rs] ^ instr->extra) & SIGN_BIT) &&
 	    ((instr->extra ^ sum) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rt] = sum;
 	break;
@@ -232,7 +850,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_LBU:
 	tmp = registers[instr->rs] + instr->extra;
 	if (!machine->ReadMem(tmp, 1, &value))
-	    return;
+	    return FALSE;
 
 	if ((value & 0x80) && (instr->opCode == OP_LB))
 	    value |= 0xffffff00;
@@ -247,10 +865,10 @@ Machine::OneInstruction(Instruction *instr)
 	tmp = registers[instr->rs] + instr->extra;
 	if (tmp & 0x1) {
 	    RaiseException(AddressErrorException, tmp);
-	    return;
+	    return FALSE;
 	}
 	if (!machine->ReadMem(tmp, 2, &value))
-	    return;
+	    return FALSE;
 
 	if ((value & 0x8000) && (instr->opCode == OP_LH))
 	    value |= 0xffff0000;
@@ -269,10 +887,10 @@ Machine::OneInstruction(Instruction *instr)
 	tmp = registers[instr->rs] + instr->extra;
 	if (tmp & 0x3) {
 	    RaiseException(AddressErrorException, tmp);
-	    return;
+	    return FALSE;
 	}
 	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 	nextLoadReg = instr->rt;
 	nextLoadValue = value;
 	break;
@@ -286,7 +904,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 	if (registers[LoadReg] == instr->rt)
 	    nextLoadValue = registers[LoadValueReg];
 	else
@@ -317,7 +935,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 	if (registers[LoadReg] == instr->rt)
 	    nextLoadValue = registers[LoadValueReg];
 	else
@@ -383,13 +1001,13 @@ Machine::OneInstruction(Instruction *instr)
       case OP_SB:
 	if (!machine->WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 1, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SH:
 	if (!machine->WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 2, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SLL:
@@ -459,7 +1077,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
 	    ((registers[instr->rs] ^ diff) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rd] = diff;
 	break;
@@ -471,7 +1089,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_SW:
 	if (!machine->WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 4, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SWL:	  
@@ -482,7 +1100,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!machine->ReadMem((tmp & ~0x3), 4, &value))
-	    return;
+	    return FALSE;
 	switch (tmp & 0x3) {
 	  case 0:
 	    value = registers[instr->rt];
@@ -501,7 +1119,7 @@ Machine::OneInstruction(Instruction *instr)
 	    break;
 	}
 	if (!machine->WriteMem((tmp & ~0x3), 4, value))
-	    return;
+	    return FALSE;
 	break;
     	
       case OP_SWR:	  
@@ -512,7 +1130,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!machine->ReadMem((tmp & ~0x3), 4, &value))
-	    return;
+	    return FALSE;
 	switch (tmp & 0x3) {
 	  case 0:
 	    value = (value & 0xffffff) | (registers[instr->rt] << 24);
@@ -528,7 +1146,7 @@ Machine::OneInstruction(Instruction *instr)
 	    break;
 	}
 	if (!machine->WriteMem((tmp & ~0x3), 4, value))
-	    return;
+	    return FALSE;
 	break;
     	
       case OP_SYSCALL:
@@ -546,7 +1164,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_RES:
       case OP_UNIMP:
 	RaiseException(IllegalInstrException, 0);
-	return;
+	return FALSE;
 	
       default:
 	ASSERT(FALSE);
@@ -562,6 +1180,7 @@ Machine::OneInstruction(Instruction *instr)
 						// are jumping into lala-land
     registers[PCReg] = registers[NextPCReg];
     registers[NextPCReg] = pcAfter;
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
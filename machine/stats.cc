@@ -10,6 +10,7 @@
 #include "copyright.h"
 #include "utility.h"
 #include "stats.h"
+#include <time.h>
 
 //----------------------------------------------------------------------
 // Statistics::Statistics
@@ -22,6 +23,67 @@ Statistics::Statistics()
     numDiskReads = numDiskWrites = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numPageIns = numPageOuts = numTLBMisses = numSuspensions = 0;
+    numCodeShares = 0;
+    numIndexReads = 0;
+    numDirPageReads = numDentryHits = numDentryMisses = 0;
+    numDecodeHits = numDecodeMisses = 0;
+    numBlockHits = numBlockMisses = 0;
+    numCacheHits = numCacheMisses = numCacheWritebacks = 0;
+    numReadAheads = numReadAheadHits = 0;
+    numDiskRequests = maxDiskLatencies = 0;
+    diskLatencies = NULL;
+    for (int i = 0; i < MaxProcessStats; i++)
+	ResetProcess(i);
+    for (int i = 0; i < MaxSyscallStats; i++)
+	syscallCalls[i] = syscallTicks[i] = 0;
+}
+
+//----------------------------------------------------------------------
+// Statistics::ResetProcess
+// 	Clear the per-process counters of "asid", which is being given
+//	to a new process.
+//----------------------------------------------------------------------
+
+void
+Statistics::ResetProcess(int asid)
+{
+    processTicks[asid] = processTLBMisses[asid] = processPageFaults[asid] = 0;
+}
+
+//----------------------------------------------------------------------
+// Statistics::RecordDiskLatency
+// 	Remember the latency of one disk request (from the time it was
+//	queued until it completed), so that Print can report the
+//	average and the 99th percentile.
+//
+//	"ticks" -- simulated time the request took
+//----------------------------------------------------------------------
+
+void
+Statistics::RecordDiskLatency(int ticks)
+{
+    if (numDiskRequests == maxDiskLatencies) {	// grow the sample array
+	int *old = diskLatencies;
+
+	maxDiskLatencies = (maxDiskLatencies == 0) ? 256 : 2 * maxDiskLatencies;
+	diskLatencies = new int[maxDiskLatencies];
+	for (int i = 0; i < numDiskRequests; i++)
+	    diskLatencies[i] = old[i];
+	delete [] old;
+    }
+    diskLatencies[numDiskRequests++] = ticks;
+}
+
+//----------------------------------------------------------------------
+// CompareInts
+// 	qsort comparison routine, for sorting latencies.
+//----------------------------------------------------------------------
+
+static int
+CompareInts(const void *a, const void *b)
+{
+    return *(const int *) a - *(const int *) b;
 }
 
 //----------------------------------------------------------------------
@@ -35,10 +97,52 @@ Statistics::Print()
 {
     printf("Ticks: total %d, idle %d, system %d, user %d\n", totalTicks, 
 	idleTicks, systemTicks, userTicks);
+    double hostSeconds = (double) clock() / CLOCKS_PER_SEC;
+    if (userTicks > 0 && hostSeconds > 0)
+	printf("User instructions: %.0f per host second\n", 
+	    userTicks / hostSeconds);
+    printf("Decode cache: hits %d, misses %d\n", numDecodeHits, 
+	numDecodeMisses);
+    if (numBlockHits + numBlockMisses > 0)
+	printf("Basic blocks: run %d, translated %d, %.1f instructions each\n",
+	    numBlockHits + numBlockMisses, numBlockMisses,
+	    (double) userTicks / UserTick / (numBlockHits + numBlockMisses));
     printf("Disk I/O: reads %d, writes %d\n", numDiskReads, numDiskWrites);
+    printf("File index: sector reads %d\n", numIndexReads);
+    printf("Name lookup: dentry hits %d, misses %d, directory page reads %d\n",
+	numDentryHits, numDentryMisses, numDirPageReads);
+    printf("Buffer cache: hits %d, misses %d, writebacks %d\n", numCacheHits,
+	numCacheMisses, numCacheWritebacks);
+    printf("Read-ahead: sectors %d, hits %d\n", numReadAheads,
+	numReadAheadHits);
+    if (numDiskRequests > 0) {
+	double total = 0;
+	for (int i = 0; i < numDiskRequests; i++)
+	    total += diskLatencies[i];
+	qsort(diskLatencies, numDiskRequests, sizeof(int), CompareInts);
+	printf("Disk latency: requests %d, average %d ticks, p99 %d ticks\n",
+	    numDiskRequests, (int) (total / numDiskRequests),
+	    diskLatencies[(99 * numDiskRequests + 99) / 100 - 1]);
+    }
     printf("Console I/O: reads %d, writes %d\n", numConsoleCharsRead, 
 	numConsoleCharsWritten);
-    printf("Paging: faults %d\n", numPageFaults);
+    printf("TLB: misses %d\n", numTLBMisses);
+    printf("Paging: faults %d, swap reads %d, swap writes %d, "
+	"suspensions %d, shared code pages %d\n", numPageFaults, numPageIns,
+	numPageOuts, numSuspensions, numCodeShares);
+    if (userTicks > 0)
+	printf("Paging: %.2f faults per 1000 user instructions\n",
+	    1000.0 * numPageFaults * UserTick / userTicks);
+    for (int i = 0; i < MaxProcessStats; i++)
+	if (processTicks[i] > 0)
+	    printf("Process %d: instructions %d, TLB misses %d (%.2f per 1000),"
+		" page faults %d\n", i, processTicks[i], processTLBMisses[i],
+		1000.0 * processTLBMisses[i] / processTicks[i],
+		processPageFaults[i]);
+    for (int i = 0; i < MaxSyscallStats; i++)
+	if (syscallCalls[i] > 0)
+	    printf("System call %d: calls %d, %.1f ticks per call\n", i,
+		syscallCalls[i], (double) syscallTicks[i] / syscallCalls[i]);
     printf("Network I/O: packets received %d, sent %d\n", numPacketsRecvd, 
 	numPacketsSent);
 }
@@ -19,6 +19,11 @@
 //
 // The fields in this class are public to make it easier to update.
 
+#define MaxProcessStats	64	// processes counted separately, by their
+				// address space identifier (ASID)
+#define MaxSyscallStats	16	// system calls counted separately, by
+				// their code (cf. SC_Halt in syscall.h)
+
 class Statistics {
   public:
     int totalTicks;      	// Total time running Nachos
@@ -33,12 +38,41 @@ class Statistics {
     int numConsoleCharsRead;	// number of characters read from the keyboard
     int numConsoleCharsWritten; // number of characters written to the display
     int numPageFaults;		// number of virtual memory page faults
+    int numTLBMisses;		// number of TLB misses
+    int numSuspensions;		// processes swapped out to make room
+    int numCodeShares;		// code pages found in memory, loaded
+				// by another process running the program
+    int numPageIns;		// pages read back from the swap file
+    int numPageOuts;		// dirty pages written to the swap file
+    int numDecodeHits;		// instructions found already decoded
+    int numDecodeMisses;	// instructions that had to be decoded
+    int numBlockHits;		// basic blocks run already translated
+    int numBlockMisses;		// basic blocks that had to be translated
     int numPacketsSent;		// number of packets sent over the network
     int numPacketsRecvd;	// number of packets received over the network
+    int numIndexReads;		// number of file index sectors read from disk
+    int numDirPageReads;	// directory pages read from directory files
+    int numDentryHits;		// path components found in the dentry cache
+    int numDentryMisses;	// path components looked up in a directory
+    int numCacheHits;		// sector requests served by the buffer cache
+    int numCacheMisses;		// sector requests that missed the cache
+    int numCacheWritebacks;	// dirty cache frames written back to disk
+    int numReadAheads;		// sectors read into the cache ahead of time
+    int numReadAheadHits;	// reads served by a read-ahead sector
+    int numDiskRequests;	// disk requests completed by SynchDisk
+    int *diskLatencies;		// queueing + service time of each request
+    int maxDiskLatencies;	// size of the diskLatencies array
+    int processTicks[MaxProcessStats];		// user instructions,
+    int processTLBMisses[MaxProcessStats];	// TLB misses and page
+    int processPageFaults[MaxProcessStats];	// faults of each process
+    int syscallCalls[MaxSyscallStats];	// calls of each system call,
+    int syscallTicks[MaxSyscallStats];	// and the time spent in them
 
     Statistics(); 		// initialize everything to zero
 
     void Print();		// print collected statistics
+    void RecordDiskLatency(int ticks);	// note one completed disk request
+    void ResetProcess(int asid);	// a new process is using "asid"
 };
 
 // Constants used to reflect the relative time an operation would
@@ -35,6 +35,7 @@ extern "C" {
 #include <sys/file.h>
 #include <sys/un.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #ifdef HOST_i386
 #include <unistd.h>
 #include <sys/time.h>
@@ -226,6 +227,23 @@ Lseek(int fd, int offset, int whence)
     ASSERT(retVal >= 0);
 }
 
+//----------------------------------------------------------------------
+// FileId
+// 	Return a number that identifies the file open as "fd" -- the
+//	same however the file was opened, and different for every other
+//	file (on the same UNIX file system): its inode number.
+//----------------------------------------------------------------------
+
+int
+FileId(int fd)
+{
+    struct stat st;
+    int retVal = fstat(fd, &st);
+
+    ASSERT(retVal >= 0);
+    return (int) st.st_ino;
+}
+
 //----------------------------------------------------------------------
 // Tell
 // 	Report the current location within an open file.
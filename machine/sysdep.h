@@ -26,6 +26,7 @@ extern int ReadPartial(int fd, char *buffer, int nBytes);
 extern void WriteFile(int fd, char *buffer, int nBytes);
 extern void Lseek(int fd, int offset, int whence);
 extern int Tell(int fd);
+extern int FileId(int fd);
 extern void Close(int fd);
 extern bool Unlink(char *name);
 
@@ -64,6 +65,9 @@ int abs(int i);
 
 #include <stdio.h>		// for printf, fprintf
 #include <string.h>		// for DEBUG, etc.
+
+void qsort(void *base, size_t nmemb, size_t size,
+	   int (*compare)(const void *, const void *));
 }
 
 #endif // SYSDEP_H
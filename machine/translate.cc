@@ -91,12 +91,13 @@ Machine::ReadMem(int addr, int size, int *value)
     ExceptionType exception;
     int physicalAddress;
     
-    DEBUG('a', "Reading VA 0x%x, size %d\n", addr, size);
-    
-    exception = Translate(addr, &physicalAddress, size, FALSE);
-    if (exception != NoException) {
+    if (!FastTranslate(addr, size, FALSE, &physicalAddress)) {
+	DEBUG('a', "Reading VA 0x%x, size %d\n", addr, size);
+	exception = Translate(addr, &physicalAddress, size, FALSE);
+	if (exception != NoException) {
 		machine->RaiseException(exception, addr);
 		return FALSE;
+	}
     }
     switch (size) {
       case 1:
@@ -140,12 +141,13 @@ Machine::WriteMem(int addr, int size, int value)
     ExceptionType exception;
     int physicalAddress;
      
-    DEBUG('a', "Writing VA 0x%x, size %d, value 0x%x\n", addr, size, value);
-
-    exception = Translate(addr, &physicalAddress, size, TRUE);
-    if (exception != NoException) {
+    if (!FastTranslate(addr, size, TRUE, &physicalAddress)) {
+	DEBUG('a', "Writing VA 0x%x, size %d, value 0x%x\n", addr, size, value);
+	exception = Translate(addr, &physicalAddress, size, TRUE);
+	if (exception != NoException) {
 		machine->RaiseException(exception, addr);
 		return FALSE;
+	}
     }
     switch (size) {
       case 1:
@@ -164,6 +166,7 @@ Machine::WriteMem(int addr, int size, int value)
 	
       default: ASSERT(FALSE);
     }
+    InvalidateDecoded(physicalAddress);	// in case it was an instruction
     
     return TRUE;
 }
@@ -177,6 +180,9 @@ Machine::WriteMem(int addr, int size, int value)
 //	address in "physAddr".  If there was an error, returns the type
 //	of the exception.
 //
+//	A successful translation is also remembered in fastXlate, so that
+//	FastTranslate can handle the next references to the same page.
+//
 //	"virtAddr" -- the virtual address to translate
 //	"physAddr" -- the place to store the physical address
 //	"size" -- the amount of memory being read or written
@@ -220,10 +226,13 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 		}
 		entry = &pageTable[vpn];
     } else {
-//        printf("with tlb\n");
-		for (entry = NULL, i = 0; i < TLBSize; i++)
-    	if (tlb[i].valid && (tlb[i].virtualPage == vpn)) {
-			entry = &tlb[i];			// FOUND!
+		TranslationEntry *set = TLBSet(vpn);
+
+		for (entry = NULL, i = 0; i < TLBWays; i++)
+    	if (set[i].valid && (set[i].virtualPage == vpn) && 
+			(set[i].asid == currentASID)) {
+			entry = &set[i];			// FOUND!
+			entry->lastUseTick = stats->totalTicks;
 			break;
 		}
 		if (entry == NULL) {				// not found
@@ -242,7 +251,7 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 
     // if the pageFrame is too big, there is something really wrong! 
     // An invalid translation was loaded into the page table or TLB. 
-    if (pageFrame >= NumPhysPages) { 
+    if (pageFrame >= (unsigned int) NumPhysPages) { 
 	DEBUG('a', "*** frame %d > %d!\n", pageFrame, NumPhysPages);
 	return BusErrorException;
     }
@@ -250,6 +259,12 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     if (writing)
 	entry->dirty = TRUE;
     *physAddr = pageFrame * PageSize + offset;
+
+    FastTranslation *fast = &fastXlate[vpn % FastXlateSize];
+    fast->vpn = vpn;
+    fast->frameAddr = pageFrame * PageSize;
+    fast->writable = entry->dirty && !entry->readOnly;
+    fast->tlbEntry = (tlb != NULL) ? entry : NULL;
     ASSERT((*physAddr >= 0) && ((*physAddr + size) <= MemorySize));
     DEBUG('a', "phys addr = 0x%x\n", *physAddr);
     return NoException;
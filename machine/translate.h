@@ -44,6 +44,7 @@ class TranslationEntry {
 	
 	//add in lab5
 	int lastUseTick; //the last tick tlb used 
+	int asid;		// The address space the entry belongs to.
 };
 
 /*
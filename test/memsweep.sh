@@ -0,0 +1,29 @@
+#!/bin/sh
+# memsweep.sh
+#	Run the test programs with main memories of different sizes, and
+#	report the page fault rate for each, to see where each program
+#	starts to thrash.
+#
+#	Usage: sh memsweep.sh [nachos binary] [replacement policy]
+#	e.g.   sh memsweep.sh ../vm/nachos clock
+#
+#	Run from the test directory, so that the programs are found.
+
+NACHOS=${1:-../vm/nachos}
+POLICY=${2:-clock}
+PROGRAMS="matmult sort"
+FRAMES="4 8 12 16 24 32 48 64"
+
+echo "policy $POLICY"
+printf "%-10s %8s %10s %12s %12s\n" program frames faults swapwrites "per 1000"
+for prog in $PROGRAMS; do
+    for frames in $FRAMES; do
+	$NACHOS -pm $frames -vp 128 -rp $POLICY -x $prog > /tmp/memsweep.$$ 2>&1
+	faults=`sed -n 's/^Paging: faults \([0-9]*\),.*/\1/p' /tmp/memsweep.$$`
+	writes=`sed -n 's/.*swap writes \([0-9]*\),.*/\1/p' /tmp/memsweep.$$`
+	rate=`sed -n 's/^Paging: \([0-9.]*\) faults per 1000.*/\1/p' /tmp/memsweep.$$`
+	printf "%-10s %8d %10s %12s %12s\n" $prog $frames \
+	    "${faults:--}" "${writes:--}" "${rate:--}"
+    done
+done
+rm -f /tmp/memsweep.$$
@@ -0,0 +1,56 @@
+/* sysbench.c 
+ *	Measure how long system calls take.  Each is made many times in
+ *	a row, so that the per-call times Nachos prints when it halts
+ *	("System call N: calls ..., ticks per call") are averages.
+ *
+ *	Reads and writes go through a file of its own, "sysbench.tmp";
+ *	Fork and Join through a child that exits at once.
+ */
+
+#include "syscall.h"
+
+#define Calls		50
+#define ChunkSize	64	/* bytes per Read or Write */
+
+char buffer[ChunkSize];
+
+void
+child()
+{
+    Exit(7);
+}
+
+int
+main()
+{
+    OpenFileId file;
+    int i;
+
+    for (i = 0; i < ChunkSize; i++)
+	buffer[i] = 'a' + i % 26;
+
+    for (i = 0; i < Calls; i++)
+	Yield();
+
+    Create("sysbench.tmp");
+    file = Open("sysbench.tmp");
+    for (i = 0; i < Calls; i++)
+	Write(buffer, ChunkSize, file);
+    Close(file);
+
+    for (i = 0; i < Calls; i++)
+	Close(Open("sysbench.tmp"));
+
+    file = Open("sysbench.tmp");
+    for (i = 0; i < Calls; i++)
+	Read(buffer, ChunkSize, file);
+    Close(file);
+
+    for (i = 0; i < Calls; i++)
+	if (Join(Fork(child)) != 7)
+	    Write("bad exit status\n", 16, ConsoleOutput);
+
+    Write("sysbench done\n", 14, ConsoleOutput);
+    Halt();
+    /* not reached */
+}
@@ -8,31 +8,52 @@
 //
 // 	Most of this file is not needed until later assignments.
 //
-// Usage: nachos -d <debugflags> -rs <random seed #>
-//		-s -x <nachos file> -c <consoleIn> <consoleOut>
-//		-f -cp <unix file> <nachos file>
-//		-p <nachos file> -r <nachos file> -l -D -t
+// Usage: nachos -d <debugflags> -rs <random seed #> -mlfq
+//		-s -bb -rp <fifo|clock|eclock|lru>
+//		-pm <frames> -tlb <entries> -tlbways <n> -vp <pages>
+//		-x <nachos file> -xb <nachos file>
+//		-c <consoleIn> <consoleOut>
+//		-f -bc <cache frames> -ds <fifo|sstf|scan|clook>
+//		-cp <unix file> <nachos file>
+//		-p <nachos file> -r <nachos file> -l -D -t -tq -tb -td -tp -tr
 //              -n <network reliability> -m <machine id>
 //              -o <other machine id>
 //              -z
 //
 //    -d causes certain debugging messages to be printed (cf. utility.h)
 //    -rs causes Yield to occur at random (but repeatable) spots
+//    -mlfq schedules threads with a multi-level feedback queue
 //    -z prints the copyright message
 //
 //  USER_PROGRAM
 //    -s causes user programs to be executed in single-step mode
+//    -bb runs user programs a basic block at a time (faster; simulated
+//	time and interrupts advance once per block)
 //    -x runs a user program
+//    -xb measures the time taken to load a user program
+//    -pm sets the number of page frames of main memory (default 32)
+//    -tlb sets the number of TLB entries (default 4)
+//    -tlbways sets the number of entries in each TLB set (default: all)
+//    -vp sets the largest number of pages of an address space (default 64)
+//    -rp sets the page replacement policy: fifo, clock (the default),
+//	eclock (enhanced clock, sparing dirty pages) or lru (approximate)
 //    -c tests the console
 //
 //  FILESYS
 //    -f causes the physical disk to be formatted
+//    -bc sets the number of sectors in the buffer cache (0 disables it)
+//    -ds sets the order queued disk requests are served in (default clook)
 //    -cp copies a file from UNIX to Nachos
 //    -p prints a Nachos file to stdout
 //    -r removes a Nachos file from the file system
 //    -l lists the contents of the Nachos directory
 //    -D prints the contents of the entire file system 
 //    -t tests the performance of the Nachos file system
+//    -tq tests the disk request queue with many concurrent readers
+//    -tb times allocating and freeing sectors in a free-sector map
+//    -td times creating and looking up files as a directory grows
+//    -tp opens a file by a deep path name, through the dentry cache
+//    -tr times several threads reading one file at once
 //
 //  NETWORK
 //    -n sets the network reliability
@@ -60,8 +81,11 @@ extern int testnum;
 // External functions used by this file
 
 extern void ThreadTest(void), Copy(char *unixFile, char *nachosFile);
-extern void Print(char *file), PerformanceTest(void);
+extern void Print(char *file), PerformanceTest(void), DiskQueueTest(void);
+extern void BitMapBenchmark(void), DirectoryBenchmark(void), PathTest(void);
+extern void ReadBenchmark(void);
 extern void StartProcess(char *file), ConsoleTest(char *in, char *out);
+extern void ExecBenchmark(char *file);
 extern void MailTest(int networkID);
 
 //----------------------------------------------------------------------
@@ -112,6 +136,10 @@ main(int argc, char **argv)
 	    ASSERT(argc > 1);
             StartProcess(*(argv + 1));
             argCount = 2;
+        } else if (!strcmp(*argv, "-xb")) {	// time loading a program
+	    ASSERT(argc > 1);
+            ExecBenchmark(*(argv + 1));
+            argCount = 2;
         } else if (!strcmp(*argv, "-c")) {      // test the console
 	    if (argc == 1)
 	        ConsoleTest(NULL, NULL);
@@ -144,6 +172,16 @@ main(int argc, char **argv)
             fileSystem->Print();
 	} else if (!strcmp(*argv, "-t")) {	// performance test
             PerformanceTest();
+	} else if (!strcmp(*argv, "-tq")) {	// disk queue test
+            DiskQueueTest();
+	} else if (!strcmp(*argv, "-tb")) {	// free map benchmark
+            BitMapBenchmark();
+	} else if (!strcmp(*argv, "-td")) {	// directory benchmark
+            DirectoryBenchmark();
+	} else if (!strcmp(*argv, "-tp")) {	// path lookup test
+            PathTest();
+	} else if (!strcmp(*argv, "-tr")) {	// concurrent read benchmark
+            ReadBenchmark();
 	}
 #endif // FILESYS
 #ifdef NETWORK
@@ -11,8 +11,8 @@
 //	end up calling FindNextToRun(), and that would put us in an 
 //	infinite loop.
 //
-// 	Very simple implementation -- no priorities, straight FIFO.
-//	Might need to be improved in later assignments.
+// 	Threads are run in order of priority, and FIFO within each
+//	priority.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -22,14 +22,110 @@
 #include "scheduler.h"
 #include "system.h"
 
+//----------------------------------------------------------------------
+// ReadyQueue::ReadyQueue
+// 	Initialize every per-priority FIFO to empty.
+//----------------------------------------------------------------------
+
+ReadyQueue::ReadyQueue()
+{
+    for (int p = 0; p <= LowestPriority; p++)
+	head[p] = tail[p] = NULL;
+    nonEmpty = 0;
+}
+
+//----------------------------------------------------------------------
+// ReadyQueue::Append
+// 	Put a thread at the end of the FIFO for its priority.
+//
+//	"thread" is the thread to be queued; it must not already be on
+//		a ready queue.
+//----------------------------------------------------------------------
+
+void
+ReadyQueue::Append(Thread *thread)
+{
+    int p = thread->getPriority();
+
+    ASSERT(p >= HighestPriority && p <= LowestPriority);
+    thread->readyNext = NULL;
+    if (head[p] == NULL) {
+	head[p] = thread;
+	nonEmpty |= (1 << p);
+    } else
+	tail[p]->readyNext = thread;
+    tail[p] = thread;
+}
+
+//----------------------------------------------------------------------
+// ReadyQueue::Remove
+// 	Remove the first thread from the highest priority non-empty FIFO.
+//	The lowest set bit of "nonEmpty" is that FIFO, since 1 is the
+//	highest priority.  Return NULL if no thread is queued.
+//----------------------------------------------------------------------
+
+Thread *
+ReadyQueue::Remove()
+{
+    Thread *thread;
+    int p;
+
+    if (nonEmpty == 0)
+	return NULL;
+    p = __builtin_ctz(nonEmpty);
+    thread = head[p];
+    head[p] = thread->readyNext;
+    if (head[p] == NULL) {
+	tail[p] = NULL;
+	nonEmpty &= ~(1 << p);
+    }
+    thread->readyNext = NULL;
+    return thread;
+}
+
+//----------------------------------------------------------------------
+// ReadyQueue::TopPriority
+// 	Return the priority of the first thread Remove would return, or
+//	LowestPriority + 1 if the queue is empty.
+//----------------------------------------------------------------------
+
+int
+ReadyQueue::TopPriority()
+{
+    if (nonEmpty == 0)
+	return LowestPriority + 1;
+    return __builtin_ctz(nonEmpty);
+}
+
+//----------------------------------------------------------------------
+// ReadyQueue::Mapcar
+// 	Apply a function to each thread on the queue, highest priority
+//	first.
+//
+//	"func" is the procedure to apply to each thread.
+//----------------------------------------------------------------------
+
+void
+ReadyQueue::Mapcar(VoidFunctionPtr func)
+{
+    for (int p = HighestPriority; p <= LowestPriority; p++)
+	for (Thread *t = head[p]; t != NULL; t = t->readyNext)
+	    (*func)((int) t);
+}
+
 //----------------------------------------------------------------------
 // Scheduler::Scheduler
 // 	Initialize the list of ready but not running threads to empty.
+//
+//	"useMLFQ" -- if TRUE, adjust thread priorities as a multi-level
+//		feedback queue; otherwise priorities are static.
 //----------------------------------------------------------------------
 
-Scheduler::Scheduler()
+Scheduler::Scheduler(bool useMLFQ)
 { 
-    readyList = new List; 
+    readyList = new ReadyQueue; 
+    mlfq = useMLFQ;
+    lastAging = 0;
 } 
 
 //----------------------------------------------------------------------
@@ -56,7 +152,7 @@ Scheduler::ReadyToRun (Thread *thread)
     DEBUG('t', "Putting thread %s on ready list.\n", thread->getName());
 
     thread->setStatus(READY);
-    readyList->SortedInsert((void *)thread, thread->getPriority());
+    readyList->Append(thread);
 }
 
 //----------------------------------------------------------------------
@@ -70,7 +166,7 @@ Scheduler::ReadyToRun (Thread *thread)
 Thread *
 Scheduler::FindNextToRun ()
 {
-    return (Thread *)readyList->Remove();
+    return readyList->Remove();
 }
 
 //----------------------------------------------------------------------
@@ -145,3 +241,91 @@ Scheduler::Print()
     printf("Ready list contents:\n");
     readyList->Mapcar((VoidFunctionPtr) ThreadPrint);
 }
+
+//----------------------------------------------------------------------
+// Scheduler::TimerTick
+// 	Called from the timer interrupt handler, with interrupts disabled.
+//	Without MLFQ, every timer interrupt is a time slice.  With MLFQ,
+//	the current thread is preempted once it has used up the quantum
+//	for its level (and is moved down a level), or as soon as a thread
+//	with a higher priority is ready.  Starving threads are aged here
+//	too.
+//
+//	Returns TRUE if the current thread should yield.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::TimerTick()
+{
+    Thread *thread = currentThread;
+    int pri = thread->getPriority();
+
+    if (!mlfq)
+	return TRUE;
+
+    if (stats->totalTicks - lastAging >= AgingInterval) {
+	Age();
+	lastAging = stats->totalTicks;
+    }
+
+    thread->ChargeTime();
+    if (thread->sliceTicks >= MLFQQuantum(pri)) {
+	if (pri < LowestPriority)
+	    thread->setPriority(pri + 1);
+	thread->sliceTicks = 0;
+	DEBUG('t', "Thread \"%s\" used its quantum, now at level %d\n",
+	      thread->getName(), thread->getPriority());
+	return TRUE;
+    }
+    return (readyList->TopPriority() < pri);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::ThreadBlocked
+// 	Called when a thread goes to sleep (waiting for I/O or on a
+//	synchronization variable).  With MLFQ the thread moves up one
+//	level and starts a new quantum, so threads that mostly wait get
+//	the CPU quickly when they wake up.
+//
+//	"thread" is the thread going to sleep.
+//----------------------------------------------------------------------
+
+void
+Scheduler::ThreadBlocked(Thread *thread)
+{
+    if (!mlfq)
+	return;
+    if (thread->getPriority() > HighestPriority)
+	thread->setPriority(thread->getPriority() - 1);
+    thread->sliceTicks = 0;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Age
+// 	Move every thread that has been on the ready list for at least
+//	StarvationTicks up one level.  All threads are taken off the
+//	queue and put back, which keeps them in FIFO order within each
+//	level.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Age()
+{
+    Thread *chain = NULL, **end = &chain;
+    Thread *thread, *next;
+
+    while ((thread = readyList->Remove()) != NULL) {
+	*end = thread;
+	end = &thread->readyNext;
+    }
+    for (thread = chain; thread != NULL; thread = next) {
+	next = thread->readyNext;
+	if (stats->totalTicks - thread->statusSince >= StarvationTicks
+		&& thread->getPriority() > HighestPriority) {
+	    thread->setPriority(thread->getPriority() - 1);
+	    DEBUG('t', "Aging thread \"%s\" to level %d\n",
+		  thread->getName(), thread->getPriority());
+	}
+	readyList->Append(thread);
+    }
+}
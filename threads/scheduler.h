@@ -13,13 +13,48 @@
 #include "list.h"
 #include "thread.h"
 
+// The following class defines the queue of ready threads: one FIFO
+// per priority, linked through Thread::readyNext, plus a bitmap of
+// the priorities whose FIFO is non-empty.  Append and Remove take
+// constant time and never allocate memory.
+
+class ReadyQueue {
+  public:
+    ReadyQueue();			// initialize to empty
+
+    void Append(Thread *thread);	// put thread at the end of the FIFO
+					// for its priority
+    Thread *Remove();			// take the first thread of the highest
+					// priority, NULL if there is none
+    bool IsEmpty() { return (nonEmpty == 0); }
+    int TopPriority();			// priority of the thread Remove would
+					// return, LowestPriority + 1 if none
+    void Mapcar(VoidFunctionPtr func);	// apply func to each thread, in
+					// the order they would be removed
+
+  private:
+    Thread *head[LowestPriority + 1];	// FIFO of ready threads for each
+    Thread *tail[LowestPriority + 1];	// priority (index 0 is unused)
+    unsigned int nonEmpty;		// bit p set if FIFO p has threads
+};
+
 // The following class defines the scheduler/dispatcher abstraction -- 
 // the data structures and operations needed to keep track of which 
 // thread is running, and which threads are ready but not running.
 
+// In MLFQ mode, priorities are levels of a multi-level feedback queue.
+// A thread that runs for its whole quantum (which is longer at lower
+// levels) drops one level, a thread that blocks rises one level, and
+// every AgingInterval threads that have waited StarvationTicks on the
+// ready queue rise one level.
+
+#define MLFQQuantum(pri)	((pri) * TimerTicks)
+#define AgingInterval		(10 * TimerTicks)
+#define StarvationTicks		(50 * TimerTicks)
+
 class Scheduler {
   public:
-    Scheduler();			// Initialize list of ready threads 
+    Scheduler(bool useMLFQ = FALSE);	// Initialize list of ready threads 
     ~Scheduler();			// De-allocate ready list
 
     void ReadyToRun(Thread* thread);	// Thread can be dispatched.
@@ -27,10 +62,20 @@ class Scheduler {
 					// list, if any, and return thread.
     void Run(Thread* nextThread);	// Cause nextThread to start running
     void Print();			// Print contents of ready list
+
+    bool IsMLFQ() { return mlfq; }
+    bool TimerTick();			// Called on each timer interrupt; 
+					// returns TRUE if the current thread
+					// should be preempted
+    void ThreadBlocked(Thread* thread);	// thread is going to sleep
     
   private:
-    List *readyList;  		// queue of threads that are ready to run,
+    ReadyQueue *readyList;	// queue of threads that are ready to run,
 				// but not running
+    bool mlfq;			// adjust priorities dynamically?
+    int lastAging;		// totalTicks when threads were last aged
+
+    void Age();			// raise threads starving on the ready list
 };
 
 #endif // SCHEDULER_H
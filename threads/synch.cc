@@ -182,3 +182,93 @@ void Condition::Broadcast(Lock* conditionLock) {
 	
 	(void) interrupt->SetLevel(oldLevel);
 }
+
+//----------------------------------------------------------------------
+// RWLock::RWLock
+// 	Initialize a readers-writer lock, so that it can be used for
+//	synchronization.  Initially, nobody holds it.
+//
+//	"debugName" is an arbitrary name, useful for debugging.
+//----------------------------------------------------------------------
+
+RWLock::RWLock(char* debugName)
+{
+    name = debugName;
+    lock = new Lock(debugName);
+    okToRead = new Condition(debugName);
+    okToWrite = new Condition(debugName);
+    readers = waitingWriters = 0;
+    writing = FALSE;
+}
+
+//----------------------------------------------------------------------
+// RWLock::~RWLock
+// 	De-allocate a readers-writer lock, when no longer needed.  
+//	Assume no one is still holding it, or waiting for it.
+//----------------------------------------------------------------------
+
+RWLock::~RWLock()
+{
+    ASSERT(readers == 0 && waitingWriters == 0 && !writing);
+    delete lock;
+    delete okToRead;
+    delete okToWrite;
+}
+
+//----------------------------------------------------------------------
+// RWLock::AcquireRead, ReleaseRead
+// 	Join or leave the threads reading.  The last reader out lets a
+//	waiting writer in.
+//----------------------------------------------------------------------
+
+void
+RWLock::AcquireRead()
+{
+    lock->Acquire();
+    while (writing || waitingWriters > 0)
+	okToRead->Wait(lock);
+    readers++;
+    lock->Release();
+}
+
+void
+RWLock::ReleaseRead()
+{
+    lock->Acquire();
+    ASSERT(readers > 0);
+    if (--readers == 0)
+	okToWrite->Signal(lock);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// RWLock::AcquireWrite, ReleaseWrite
+// 	Become, or stop being, the only thread holding the lock.  When a
+//	writer leaves, the next waiting writer goes first; if there is 
+//	none, all the waiting readers go in together.
+//----------------------------------------------------------------------
+
+void
+RWLock::AcquireWrite()
+{
+    lock->Acquire();
+    waitingWriters++;
+    while (writing || readers > 0)
+	okToWrite->Wait(lock);
+    waitingWriters--;
+    writing = TRUE;
+    lock->Release();
+}
+
+void
+RWLock::ReleaseWrite()
+{
+    lock->Acquire();
+    ASSERT(writing);
+    writing = FALSE;
+    if (waitingWriters > 0)
+	okToWrite->Signal(lock);
+    else
+	okToRead->Broadcast(lock);
+    lock->Release();
+}
@@ -2,7 +2,8 @@
 //	Data structures for synchronizing threads.
 //
 //	Three kinds of synchronization are defined here: semaphores,
-//	locks, and condition variables.  The implementation for
+//	locks, and condition variables.  Readers-writer locks are built
+//	out of the last two.  The implementation for
 //	semaphores is given; for the latter two, only the procedure
 //	interface is given -- they are to be implemented as part of 
 //	the first assignment.
@@ -137,4 +138,38 @@ class Condition {
  	List *queue;
  	// plus some other stuff you'll need to define
 };
+
+// The following class defines a "readers-writer lock".  Any number of
+// threads may hold it for reading at once, but a thread holding it for
+// writing holds it alone:
+//
+//	AcquireRead -- wait until no thread is writing, or waiting to
+//		write, then join the readers
+//
+//	AcquireWrite -- wait until no thread is reading or writing, then
+//		become the writer
+//
+// Waiting writers go ahead of readers that arrive after them, so that a
+// steady stream of readers can't starve a writer.
+
+class RWLock {
+  public:
+    RWLock(char* debugName);		// initialize lock to be FREE
+    ~RWLock();				// deallocate lock
+    char* getName() { return name; }	// debugging assist
+
+    void AcquireRead();			// share the lock with other readers
+    void ReleaseRead();
+    void AcquireWrite();		// hold the lock alone
+    void ReleaseWrite();
+
+  private:
+    char* name;				// for debugging
+    Lock *lock;				// protects the fields below
+    Condition *okToRead;		// signalled when a writer leaves
+    Condition *okToWrite;		// signalled when the lock is free
+    int readers;			// threads holding it for reading
+    int waitingWriters;			// threads waiting to write
+    bool writing;			// is a thread holding it to write?
+};
 #endif // SYNCH_H
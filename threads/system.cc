@@ -36,8 +36,16 @@ SynchFiles  *synchFiles = new SynchFiles;         //add in lab 6
 
 #ifdef USER_PROGRAM	// requires either FILESYS or FILESYS_STUB
 Machine *machine;	// user program memory and registers
+int numPhysPages = DefaultNumPhysPages;	// size of main memory, in pages
+int tlbSize = DefaultTLBSize;		// number of TLB entries
+int tlbWays = 0;			// TLB associativity (0: fully)
+AddrSpace *asidTable[NumASIDs];		// the address space using each ASID
+int numVirPages = DefaultNumVirPages;	// largest address space, in pages
 BitMap *memoryBitMap;  //
-PhysMemoryManager *physMemoryManager = new PhysMemoryManager;
+PhysMemoryManager *physMemoryManager;
+char SwapFileName[] = "SWAP";
+OpenFile *swapFile = NULL;
+BitMap *swapMap = NULL;
 #endif
 
 #ifdef NETWORK
@@ -69,7 +77,7 @@ extern void Cleanup();
 static void
 TimerInterruptHandler(int dummy)
 {
-    if (interrupt->getStatus() != IdleMode)
+    if (interrupt->getStatus() != IdleMode && scheduler->TimerTick())
 	interrupt->YieldOnReturn();
 }
 
@@ -91,14 +99,20 @@ Initialize(int argc, char **argv)
 	int argCount;
     char* debugArgs = "";
     bool randomYield = FALSE;
+    bool mlfq = FALSE;			// multi-level feedback queue scheduling
 	
 #ifdef USER_PROGRAM
-	memoryBitMap = new BitMap(MemorySize);
     bool debugUserProg = FALSE;	// single step user program
+    bool basicBlocks = FALSE;	// run user code a basic block at a time
+    ReplacementPolicy replacePolicy = ReplaceClock;	// page replacement
 #endif
 #ifdef FILESYS_NEEDED
     bool format = FALSE;	// format disk
 #endif
+#ifdef FILESYS
+    int cacheFrames = DefaultCacheFrames;	// buffer cache size, in sectors
+    DiskSchedPolicy diskPolicy = DiskCLOOK;	// disk request ordering
+#endif
 #ifdef NETWORK
     double rely = 1;		// network reliability
     int netname = 0;		// UNIX socket name
@@ -119,15 +133,73 @@ Initialize(int argc, char **argv)
 						// number generator
 	    randomYield = TRUE;
 	    argCount = 2;
+	} else if (!strcmp(*argv, "-mlfq")) {
+	    mlfq = TRUE;
 	}
 #ifdef USER_PROGRAM
 	if (!strcmp(*argv, "-s"))
 	    debugUserProg = TRUE;
+	else if (!strcmp(*argv, "-bb"))
+	    basicBlocks = TRUE;
+	else if (!strcmp(*argv, "-pm")) {
+	    ASSERT(argc > 1);
+	    numPhysPages = atoi(*(argv + 1));
+	    ASSERT(numPhysPages > 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-tlb")) {
+	    ASSERT(argc > 1);
+	    tlbSize = atoi(*(argv + 1));
+	    ASSERT(tlbSize > 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-tlbways")) {
+	    ASSERT(argc > 1);
+	    tlbWays = atoi(*(argv + 1));
+	    ASSERT(tlbWays > 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-vp")) {
+	    ASSERT(argc > 1);
+	    numVirPages = atoi(*(argv + 1));
+	    ASSERT(numVirPages > 0);
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-rp")) {
+	    ASSERT(argc > 1);
+	    if (!strcmp(*(argv + 1), "fifo"))
+		replacePolicy = ReplaceFIFO;
+	    else if (!strcmp(*(argv + 1), "clock"))
+		replacePolicy = ReplaceClock;
+	    else if (!strcmp(*(argv + 1), "eclock"))
+		replacePolicy = ReplaceEnhancedClock;
+	    else if (!strcmp(*(argv + 1), "lru"))
+		replacePolicy = ReplaceLRU;
+	    else
+		ASSERT(FALSE);		// unknown page replacement policy
+	    argCount = 2;
+	}
 #endif
 #ifdef FILESYS_NEEDED
 	if (!strcmp(*argv, "-f"))
 	    format = TRUE;
 #endif
+#ifdef FILESYS
+	if (!strcmp(*argv, "-bc")) {
+	    ASSERT(argc > 1);
+	    cacheFrames = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-ds")) {
+	    ASSERT(argc > 1);
+	    if (!strcmp(*(argv + 1), "fifo"))
+		diskPolicy = DiskFIFO;
+	    else if (!strcmp(*(argv + 1), "sstf"))
+		diskPolicy = DiskSSTF;
+	    else if (!strcmp(*(argv + 1), "scan"))
+		diskPolicy = DiskSCAN;
+	    else if (!strcmp(*(argv + 1), "clook"))
+		diskPolicy = DiskCLOOK;
+	    else
+		ASSERT(FALSE);		// unknown disk scheduling policy
+	    argCount = 2;
+	}
+#endif
 #ifdef NETWORK
 	if (!strcmp(*argv, "-l")) {
 	    ASSERT(argc > 1);
@@ -144,7 +216,7 @@ Initialize(int argc, char **argv)
     DebugInit(debugArgs);			// initialize DEBUG messages
     stats = new Statistics();			// collect statistics
     interrupt = new Interrupt;			// start up interrupt handling
-    scheduler = new Scheduler();		// initialize the ready queue
+    scheduler = new Scheduler(mlfq);		// initialize the ready queue
 //    if (randomYield)				// start the timer (if needed)
 //open the timer to make user-prog auto switch
 	timer = new Timer(TimerInterruptHandler, 0, randomYield);
@@ -161,11 +233,15 @@ Initialize(int argc, char **argv)
     CallOnUserAbort(Cleanup);			// if user hits ctl-C
     
 #ifdef USER_PROGRAM
-    machine = new Machine(debugUserProg);	// this must come first
+    if (tlbWays == 0)
+	tlbWays = tlbSize;
+    machine = new Machine(debugUserProg, basicBlocks);	// this must come first
+    physMemoryManager = new PhysMemoryManager(replacePolicy);
+    memoryBitMap = new BitMap(NumPhysPages);
 #endif
 
 #ifdef FILESYS
-    synchDisk = new SynchDisk("DISK");
+    synchDisk = new SynchDisk("DISK", cacheFrames, diskPolicy);
 #endif
 
 #ifdef FILESYS_NEEDED
@@ -191,6 +267,12 @@ Cleanup()
     
 #ifdef USER_PROGRAM
     delete machine;
+    delete physMemoryManager;
+    delete memoryBitMap;
+    if (swapFile != NULL) {
+	fileSystem->Remove(SwapFileName);	// while it is open: the file
+	delete swapFile;			// system only removes open files
+    }
 #endif
 
 #ifdef FILESYS_NEEDED
@@ -198,6 +280,7 @@ Cleanup()
 #endif
 
 #ifdef FILESYS
+    synchDisk->Flush();				// write back the buffer cache
     delete synchDisk;
 #endif
     
@@ -49,6 +49,13 @@ extern Timer *timer;				// the hardware alarm clock
 extern Machine *machine;	// user program memory and registers
 extern BitMap *memoryBitMap; // bitmap to record the memory used of machine->mainMemory
 extern PhysMemoryManager *physMemoryManager;
+extern AddrSpace *asidTable[];	// the address space using each ASID
+
+class OpenFile;
+extern char SwapFileName[];	// name of the swap file
+extern OpenFile *swapFile;	// where evicted dirty pages are kept,
+				// created on the first page-out
+extern BitMap *swapMap;		// which pages of the swap file are in use
 #endif
 
 #ifdef FILESYS_NEEDED 		// FILESYS or FILESYS_STUB 
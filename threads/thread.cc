@@ -49,6 +49,9 @@ Thread::Thread(char* threadName)
     stackTop = NULL;
     stack = NULL;
     status = JUST_CREATED;
+    readyNext = NULL;
+    runTicks = readyTicks = blockedTicks = sliceTicks = 0;
+    statusSince = stats->totalTicks;
 #ifdef USER_PROGRAM
     space = NULL;
 #endif
@@ -78,6 +81,9 @@ Thread::Thread(char* threadName, int pri)
     stackTop = NULL;
     stack = NULL;
     status = JUST_CREATED;
+    readyNext = NULL;
+    runTicks = readyTicks = blockedTicks = sliceTicks = 0;
+    statusSince = stats->totalTicks;
 #ifdef USER_PROGRAM
     space = NULL;
 #endif
@@ -194,6 +200,10 @@ Thread::Finish ()
     
     DEBUG('t', "Finishing thread \"%s\"\n", getName());
     
+    ChargeTime();
+    DEBUG('T', "Thread \"%s\": run %d, ready %d, blocked %d ticks\n",
+	  getName(), runTicks, readyTicks, blockedTicks);
+
     threadToBeDestroyed = currentThread;
     Sleep();					// invokes SWITCH
     // not reached
@@ -264,13 +274,57 @@ Thread::Sleep ()
     
     DEBUG('t', "Sleeping thread \"%s\"\n", getName());
 
-    status = BLOCKED;
+    setStatus(BLOCKED);
+    scheduler->ThreadBlocked(this);
     while ((nextThread = scheduler->FindNextToRun()) == NULL)
 	interrupt->Idle();	// no one to run, wait for an interrupt
         
     scheduler->Run(nextThread); // returns when we've been signalled
 }
 
+//----------------------------------------------------------------------
+// Thread::setStatus
+// 	Change the thread's status.  The time since the last change is
+//	charged to the counter for the old status first.
+//
+//	"st" is the new status
+//----------------------------------------------------------------------
+
+void
+Thread::setStatus(ThreadStatus st)
+{
+    ChargeTime();
+    status = st;
+}
+
+//----------------------------------------------------------------------
+// Thread::ChargeTime
+// 	Add the simulated time spent in the current status since the last
+//	status change to the matching counter, and restart the interval.
+//----------------------------------------------------------------------
+
+void
+Thread::ChargeTime()
+{
+    int elapsed = stats->totalTicks - statusSince;
+
+    switch (status) {
+      case RUNNING:
+	runTicks += elapsed;
+	sliceTicks += elapsed;
+	break;
+      case READY:
+	readyTicks += elapsed;
+	break;
+      case BLOCKED:
+	blockedTicks += elapsed;
+	break;
+      default:				// JUST_CREATED
+	break;
+    }
+    statusSince = stats->totalTicks;
+}
+
 //----------------------------------------------------------------------
 // ThreadFinish, InterruptEnable, ThreadPrint
 //	Dummy functions because C++ does not allow a pointer to a member
@@ -59,6 +59,10 @@
 // Thread state
 enum ThreadStatus { JUST_CREATED, RUNNING, READY, BLOCKED };
 
+// Thread priorities run from HighestPriority to LowestPriority
+#define HighestPriority	1
+#define LowestPriority	10
+
 // external function, dummy routine whose sole job is to call Thread::Print
 extern void ThreadPrint(int arg);	 
 
@@ -102,12 +106,26 @@ class Thread {
     
     void CheckOverflow();   			// Check if thread has 
 						// overflowed its stack
-    void setStatus(ThreadStatus st) { status = st; }
+    void setStatus(ThreadStatus st);	// change status, charging the time
+					// spent in the old one
+    void ChargeTime();			// bring the tick counters up to date
     char* getName() { return (name); }
     void Print() { printf("%s, pid:%d\n", name, this->id); }
 	void setPriority(int pri) { this->priority = pri; }
 	int getPriority() {return this->priority;}
 
+    Thread *readyNext;			// next thread in the same ready
+					// queue (cf. ReadyQueue)
+
+    // Simulated time spent in each state, up to the last status change
+    // (or ChargeTime).  Used by the MLFQ scheduler, and to measure
+    // response time.
+    int runTicks;			// time spent RUNNING
+    int readyTicks;			// time spent READY, waiting for the CPU
+    int blockedTicks;			// time spent BLOCKED
+    int sliceTicks;			// run time in the current quantum
+    int statusSince;			// totalTicks at the last status change
+
   private:
     // some of the private data for this class is listed above
     
@@ -179,6 +179,140 @@ void ThreadTest_lab4() {
 	currentThread->Finish();
 }
 
+//----------------------------------------------------------------------
+// InterruptBenchmark
+// 	Measure the cost of Interrupt::Schedule and CheckIfDue, by 
+//	having BenchDevices simulated devices each keep one interrupt
+//	pending, rescheduling it a random time ahead whenever it fires,
+//	until BenchEvents interrupts have been delivered.  Simulated
+//	time is advanced by calling OneTick directly.
+//----------------------------------------------------------------------
+
+#define BenchDevices	64
+#define BenchEvents	2000000
+
+static int benchScheduled, benchFired;
+
+static void
+BenchHandler(int which)
+{
+    benchFired++;
+    if (benchScheduled < BenchEvents) {
+	benchScheduled++;
+	interrupt->Schedule(BenchHandler, which, 1 + Random() % 1000, DiskInt);
+    }
+}
+
+void
+InterruptBenchmark()
+{
+    int i;
+    clock_t start = clock();
+    double seconds;
+
+    benchScheduled = benchFired = 0;
+    for (i = 0; i < BenchDevices; i++) {
+	benchScheduled++;
+	interrupt->Schedule(BenchHandler, i, 1 + Random() % 1000, DiskInt);
+    }
+    while (benchFired < benchScheduled)
+	interrupt->OneTick();
+
+    seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+    printf("%d interrupts from %d devices in %.2f seconds", benchFired,
+	BenchDevices, seconds);
+    if (seconds > 0)
+	printf(" (%.0f interrupts/second)", benchFired / seconds);
+    printf("\n");
+}
+
+//----------------------------------------------------------------------
+// SchedulerBenchmark
+// 	Compare the ready queue used by the Scheduler with the sorted
+//	List it replaced, then measure the context switch rate of the
+//	real scheduler.
+//
+//	First BenchQueueThreads threads, spread over all priorities,
+//	are cycled through each queue (remove the first, put it back)
+//	BenchQueueOps times, as Thread::Yield does.  Then BenchThreads
+//	threads are forked, and each yields BenchYields times.
+//----------------------------------------------------------------------
+
+#define BenchQueueThreads	120
+#define BenchQueueOps		1000000
+#define BenchThreads		100
+#define BenchYields		1000
+
+static Semaphore *benchDone;
+
+static void
+BenchYielder(int which)
+{
+    for (int i = 0; i < BenchYields; i++)
+	currentThread->Yield();
+    benchDone->V();
+}
+
+static double
+Seconds(clock_t start)
+{
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+void
+SchedulerBenchmark()
+{
+    Thread *threads[BenchQueueThreads];
+    List *list = new List;
+    ReadyQueue *queue = new ReadyQueue;
+    Thread *t;
+    clock_t start;
+    int i;
+
+    for (i = 0; i < BenchQueueThreads; i++) {
+	threads[i] = new Thread("bench", 1 + i % LowestPriority);
+	list->SortedInsert((void *) threads[i], threads[i]->getPriority());
+	queue->Append(threads[i]);
+    }
+
+    start = clock();
+    for (i = 0; i < BenchQueueOps; i++) {
+	t = (Thread *) list->Remove();
+	list->SortedInsert((void *) t, t->getPriority());
+    }
+    printf("sorted List: %d operations on %d threads in %.2f seconds\n",
+	BenchQueueOps, BenchQueueThreads, Seconds(start));
+
+    start = clock();
+    for (i = 0; i < BenchQueueOps; i++)
+	queue->Append(queue->Remove());
+    printf("ReadyQueue: %d operations on %d threads in %.2f seconds\n",
+	BenchQueueOps, BenchQueueThreads, Seconds(start));
+
+    while (queue->Remove() != NULL)
+	;
+    for (i = 0; i < BenchQueueThreads; i++)
+	delete threads[i];
+    delete list;
+    delete queue;
+
+    benchDone = new Semaphore("bench done", 0);
+    start = clock();
+    for (i = 0; i < BenchThreads; i++) {
+	t = new Thread("yielder");
+	t->Fork(BenchYielder, i);
+    }
+    for (i = 0; i < BenchThreads; i++)
+	benchDone->P();
+    double seconds = Seconds(start);
+    printf("%d threads yielded %d times each in %.2f seconds", BenchThreads,
+	BenchYields, seconds);
+    if (seconds > 0)
+	printf(" (%.0f switches/second)", BenchThreads * BenchYields / seconds);
+    printf("\n");
+    delete benchDone;
+}
+
 void
 ThreadTest()
 {
@@ -192,6 +326,12 @@ ThreadTest()
 	case 4:
 		ThreadTest_lab4();
 		break;
+	case 5:
+		InterruptBenchmark();
+		break;
+	case 6:
+		SchedulerBenchmark();
+		break;
     default:
 		printf("No test specified.\n");
 		break;
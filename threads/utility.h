@@ -8,6 +8,7 @@
 //
 //	'+' -- turn on all debug messages
 //   	't' -- thread system
+//   	'T' -- per-thread run/ready/blocked times, when a thread finishes
 //   	's' -- semaphores, locks, and conditions
 //   	'i' -- interrupt emulation
 //   	'm' -- machine emulation (USER_PROGRAM)
@@ -18,7 +18,6 @@
 #include "copyright.h"
 #include "system.h"
 #include "addrspace.h"
-#include "noff.h"
 #ifdef HOST_SPARC
 #include <strings.h>
 #endif
@@ -45,11 +44,81 @@ SwapHeader (NoffHeader *noffH)
 	noffH->uninitData.inFileAddr = WordToHost(noffH->uninitData.inFileAddr);
 }
 
+//----------------------------------------------------------------------
+// ReadSegment
+// 	Copy the part of a segment of the object file that falls within
+//	virtual addresses [virtAddr, virtAddr + size) into "into", which
+//	holds that range.
+//----------------------------------------------------------------------
+
+static void
+ReadSegment(OpenFile *executable, Segment *seg, int virtAddr, int size, 
+	char *into)
+{
+    int from = max(virtAddr, seg->virtualAddr);
+    int to = min(virtAddr + size, seg->virtualAddr + seg->size);
+    int numRead;
+
+    if (from >= to)
+	return;
+    numRead = executable->ReadAt(&into[from - virtAddr], to - from,
+		seg->inFileAddr + (from - seg->virtualAddr));
+    ASSERT(numRead == to - from);
+}
+
+//----------------------------------------------------------------------
+// Program::Program
+// 	Read the header of the program in the file "executable", which
+//	must be in NOFF format.
+//----------------------------------------------------------------------
+
+Program::Program(OpenFile *executable)
+{
+    file = executable;
+    executable->ReadAt((char *)&noffH, sizeof(noffH), 0);
+    if ((noffH.noffMagic != NOFFMAGIC) && 
+		(WordToHost(noffH.noffMagic) == NOFFMAGIC))
+    	SwapHeader(&noffH);
+    ASSERT(noffH.noffMagic == NOFFMAGIC);
+    refs = 1;
+}
+
+//----------------------------------------------------------------------
+// Program::~Program
+// 	The last address space running the program is gone; close the 
+//	file.
+//----------------------------------------------------------------------
+
+Program::~Program()
+{
+    delete file;
+}
+
+//----------------------------------------------------------------------
+// NewASID
+// 	Find a free address space identifier for "space", and start its
+//	per-process statistics afresh.
+//----------------------------------------------------------------------
+
+static int
+NewASID(AddrSpace *space)
+{
+    int asid;
+
+    for (asid = 0; asid < NumASIDs && asidTable[asid] != NULL; asid++)
+	;
+    ASSERT(asid < NumASIDs);			// too many address spaces
+    asidTable[asid] = space;
+    stats->ResetProcess(asid);
+    return asid;
+}
+
 //----------------------------------------------------------------------
 // AddrSpace::AddrSpace
 // 	Create an address space to run a user program.
-//	Load the program from a file "executable", and set everything
-//	up so that we can start executing user instructions.
+//	Read the header of the program in the file "executable", and set 
+//	everything up so that we can start executing user instructions;
+//	the program itself is read in a page at a time, as it runs.
 //
 //	Assumes that the object code file is in NOFF format.
 //
@@ -63,14 +132,10 @@ SwapHeader (NoffHeader *noffH)
 AddrSpace::AddrSpace(OpenFile *executable)
 {
 	isInited = false;
-	NoffHeader noffH;
     unsigned int i, size;
 
-    executable->ReadAt((char *)&noffH, sizeof(noffH), 0);
-    if ((noffH.noffMagic != NOFFMAGIC) && 
-		(WordToHost(noffH.noffMagic) == NOFFMAGIC))
-    	SwapHeader(&noffH);
-    ASSERT(noffH.noffMagic == NOFFMAGIC);
+    program = new Program(executable);
+    NoffHeader &noffH = program->noffH;
 
 // how big is address space?
     size = noffH.code.size + noffH.initData.size + noffH.uninitData.size 
@@ -79,86 +144,152 @@ AddrSpace::AddrSpace(OpenFile *executable)
     numPages = divRoundUp(size, PageSize);
     size = numPages * PageSize;
 
-    ASSERT(numPages <= NumVirPages);		// check we're not trying
+    ASSERT(numPages <= (unsigned int) NumVirPages);		// check we're not trying
 						// to run anything too big --
 						// at least until we have
 						// virtual memory
 
     DEBUG('a', "Initializing address space, num pages %d, size %d\n", 
 					numPages, size);
-// first, set up the translation 
+// first, set up the translation; no page is in memory yet, each is
+// read in from the executable (or zero-filled) when it is first touched
+// (cf. AddrSpace::LoadPage)
+    asid = NewASID(this);
+
     pageTable = new TranslationEntry[numPages];
+    copyOnWrite = new bool[numPages];
+    swapSlot = new int[numPages];
     for (i = 0; i < numPages; i++) {
-		pageTable[i].virtualPage = i;	// for now, virtual page # = phys page #
-<<<<<<< HEAD
-		pageTable[i].physicalPage = memoryBitMap->Find();
-		printf("the virtural page is %d, and find physical page is %d with BitMap\n", i, pageTable[i].physicalPage);
-=======
+		pageTable[i].virtualPage = i;
 		pageTable[i].physicalPage = 0;
-		//memoryBitMap->Find();
-	//	printf("the virtural page is %d, and find physical page is %d with BitMap\n", i, pageTable[i].physicalPage);
->>>>>>> e1161f913130ed97fdc5d8bf7b9d50d8f26f1799
-
 		pageTable[i].valid = false;
 		pageTable[i].use = false;
 		pageTable[i].dirty = false;
-		pageTable[i].readOnly = false;  // if the code segment was entirely on 
-					// a separate page, we could set its 
-					// pages to be read-only
-   
-   }
-    
-// zero out the entire address space, to zero the unitialized data segment 
-// and the stack segment
-
-//	can't do bzero, it will erase the previous userprogram data
-//	bzero(machine->mainMemory, size);
-
-	virDisk = new char[size];
-// then, copy in the code and data segments into memory and virtual disk   
-	if (noffH.code.size > 0) {
-        DEBUG('a', "Initializing code segment, at 0x%x, size %d\n", 
-			noffH.code.virtualAddr, noffH.code.size);
-        
-		executable->ReadAt(&(virDisk[noffH.code.virtualAddr]), (int)noffH.code.size, (int)noffH.code.inFileAddr);
-		
-		int inFileAddr = noffH.code.inFileAddr;
-		for (i = 0; i < noffH.code.size; i++) {
-			int virAddr = noffH.code.virtualAddr + i;
-			int vpn = virAddr / PageSize;
-			int offset = virAddr % PageSize;
-			int phyAddr = pageTable[vpn].physicalPage*PageSize + offset;
-			executable->ReadAt(&(machine->mainMemory[phyAddr]),1, inFileAddr++);
-   		}
+		pageTable[i].readOnly = IsCodePage(i);	// pages that hold
+					// only code can be shared by every
+					// process running the program
+		pageTable[i].asid = asid;
+		copyOnWrite[i] = false;
+		swapSlot[i] = -1;
    }
-    if (noffH.initData.size > 0) {
-        DEBUG('a', "Initializing data segment, at 0x%x, size %d\n", 
-			noffH.initData.virtualAddr, noffH.initData.size);
-        
-		executable->ReadAt(&(virDisk[noffH.initData.virtualAddr]), noffH.initData.size, noffH.initData.inFileAddr);
-		
-
-		int inFileAddr = noffH.initData.inFileAddr;
-		for (i = 0; i < noffH.initData.size; i++) {
-			int virAddr = noffH.initData.virtualAddr + i;
-			int vpn = virAddr / PageSize;
-			int offset = virAddr % PageSize;
-			int phyAddr = pageTable[vpn].physicalPage*PageSize + offset;
-			executable->ReadAt(&(machine->mainMemory[phyAddr]),1, inFileAddr++);
-   		}
-    }
+    for (i = 0; i < MaxOpenFiles; i++)
+	openFiles[i] = NULL;
+    pid = -1;
+    residentPages = frameQuota = numFaults = 0;
+    wantedQuota = InitialFrameQuota;
+    lastFaultTick = startTick = stats->userTicks;
+    suspended = false;
+    DEBUG('a', "Code segment at 0x%x, size %d; data at 0x%x, size %d\n", 
+	noffH.code.virtualAddr, noffH.code.size,
+	noffH.initData.virtualAddr, noffH.initData.size);
 
 	DEBUG('a', "AddrSpace finished\n");
 }
 
+//----------------------------------------------------------------------
+// AddrSpace::AddrSpace
+// 	Create a copy of the address space "parent", the running one, 
+//	for a child process (cf. the Fork system call).
+//
+//	No page is copied now.  The pages the parent has in memory are
+//	shared, marked read-only in both page tables, until either 
+//	process writes to one of them (cf. CopyOnWrite).  Pages the 
+//	parent has in swap are copied to slots of the child's own, and
+//	pages it has not touched yet are read from the program when the
+//	child touches them, as for any other address space.
+//
+//	The child starts with no files open but the console.
+//----------------------------------------------------------------------
+
+AddrSpace::AddrSpace(AddrSpace *parent)
+{
+    unsigned int i;
+    char page[PageSize];
+    int numRead, numWritten;
+
+    isInited = true;
+    program = parent->program;
+    program->refs++;
+    numPages = parent->numPages;
+    asid = NewASID(this);
+
+    // the TLB may let the parent write to the pages we are about to 
+    // share, and may know they are dirty
+    parent->SyncTLB();
+    for (i = 0; i < (unsigned int) TLBSize; i++)
+	if (machine->tlb[i].asid == parent->asid)
+	    machine->tlb[i].valid = false;
+    machine->FlushFastTranslations();
+
+    pageTable = new TranslationEntry[numPages];
+    copyOnWrite = new bool[numPages];
+    swapSlot = new int[numPages];
+    residentPages = 0;
+    for (i = 0; i < numPages; i++) {
+	TranslationEntry *entry = &parent->pageTable[i];
+
+	pageTable[i] = *entry;
+	pageTable[i].asid = asid;
+	pageTable[i].use = false;
+	copyOnWrite[i] = false;
+	swapSlot[i] = -1;
+	if (entry->valid) {
+	    physMemoryManager->refCount[entry->physicalPage]++;
+	    if (!entry->readOnly)		// code stays read-only
+		parent->copyOnWrite[i] = true;
+	    entry->readOnly = pageTable[i].readOnly = true;
+	    copyOnWrite[i] = parent->copyOnWrite[i];
+	    // our copy of the page is in neither our swap nor the 
+	    // program, if it was ever written
+	    pageTable[i].dirty = entry->dirty || parent->swapSlot[i] != -1;
+	    residentPages++;
+	} else if (parent->swapSlot[i] != -1) {
+	    swapSlot[i] = swapMap->Find();
+	    ASSERT(swapSlot[i] != -1);		// out of swap space
+	    numRead = swapFile->ReadAt(page, PageSize, 
+				parent->swapSlot[i] * PageSize);
+	    ASSERT(numRead == PageSize);
+	    numWritten = swapFile->WriteAt(page, PageSize, 
+				swapSlot[i] * PageSize);
+	    ASSERT(numWritten == PageSize);
+	}
+    }
+    for (i = 0; i < MaxOpenFiles; i++)
+	openFiles[i] = NULL;
+    pid = -1;
+    frameQuota = numFaults = 0;			// admitted at the first fault
+    wantedQuota = max(parent->frameQuota, InitialFrameQuota);
+    lastFaultTick = startTick = stats->userTicks;
+    suspended = false;
+    DEBUG('a', "Forked address space, %d pages shared\n", residentPages);
+}
+
 //----------------------------------------------------------------------
 // AddrSpace::~AddrSpace
-// 	Dealloate an address space.  Nothing for now!
+// 	Dealloate an address space, giving back its page frames, and
+//	closing the files the program left open.
 //----------------------------------------------------------------------
 
 AddrSpace::~AddrSpace()
 {
-   delete pageTable;
+    DEBUG('a', "Address space: %d page faults, %.2f per 1000 instructions; "
+	"%d resident pages, quota %d\n", numFaults, FaultRate(),
+	residentPages, frameQuota);
+    for (int i = FirstFileId; i < MaxOpenFiles; i++)
+	CloseFile(i);
+    physMemoryManager->Release(this);
+    for (int i = 0; i < TLBSize; i++)		// the ASID will be reused
+	if (machine->tlb[i].asid == asid)
+	    machine->tlb[i].valid = false;
+    asidTable[asid] = NULL;
+    for (unsigned int i = 0; i < numPages; i++)
+	if (swapSlot[i] != -1)
+	    swapMap->Clear(swapSlot[i]);
+    delete [] swapSlot;
+    delete [] copyOnWrite;
+    delete [] pageTable;
+    if (--program->refs == 0)
+	delete program;
 }
 
 //----------------------------------------------------------------------
@@ -195,33 +326,273 @@ AddrSpace::InitRegisters()
     DEBUG('a', "Initializing stack register to %d\n", numPages * PageSize - 16);
 }
 
+//----------------------------------------------------------------------
+// OpenSwap
+// 	Open the swap file, the first time a page has to be written to
+//	it, creating it unless one was left over from a run that didn't
+//	clean up.  Each page of the file holds one virtual page; swapMap 
+//	says which are in use, so old contents don't matter.
+//----------------------------------------------------------------------
+
+static void
+OpenSwap()
+{
+    if (swapFile != NULL)
+	return;
+    swapFile = fileSystem->Open(SwapFileName);
+    if (swapFile == NULL) {
+	fileSystem->Create(SwapFileName, NumSwapPages * PageSize);
+	swapFile = fileSystem->Open(SwapFileName);
+    }
+    ASSERT(swapFile != NULL);
+    swapMap = new BitMap(NumSwapPages);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::LoadPage
+// 	Fill the page frame "frame" with the contents of virtual page
+//	"vpn", on the first reference to the page since it was last
+//	evicted (or since the program started).
+//
+//	A page that was written to swap comes back from there.
+//	Otherwise it is built from the executable: it is zero-filled,
+//	and then whatever parts of the code and data segments fall in it
+//	are read in.  Pages of the uninitialized data and the stack thus
+//	cost no disk reads at all.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::LoadPage(int vpn, char *frame)
+{
+    int numRead;
+
+    ASSERT(vpn >= 0 && vpn < (int) numPages);
+    pageTable[vpn].dirty = false;
+    if (swapSlot[vpn] != -1) {
+	DEBUG('a', "Swapping in page %d from slot %d\n", vpn, swapSlot[vpn]);
+	numRead = swapFile->ReadAt(frame, PageSize, swapSlot[vpn] * PageSize);
+	ASSERT(numRead == PageSize);
+	stats->numPageIns++;
+	return;
+    }
+    DEBUG('a', "Demand loading page %d\n", vpn);
+    bzero(frame, PageSize);
+    ReadSegment(program->file, &program->noffH.code, vpn * PageSize, 
+		PageSize, frame);
+    ReadSegment(program->file, &program->noffH.initData, vpn * PageSize, 
+		PageSize, frame);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::SavePage
+// 	Virtual page "vpn" is losing its page frame "frame".  If the page
+//	has been modified since it was loaded, write it to its slot in
+//	the swap file (allocating one the first time).  A clean page
+//	needs no I/O: its swap slot, or the executable, still holds it.
+//
+//	The caller must have copied back the dirty bit from the TLB
+//	(cf. SyncTLB).
+//----------------------------------------------------------------------
+
+void
+AddrSpace::SavePage(int vpn, char *frame)
+{
+    int numWritten;
+
+    ASSERT(vpn >= 0 && vpn < (int) numPages);
+    if (!pageTable[vpn].dirty)
+	return;
+    OpenSwap();
+    if (swapSlot[vpn] == -1) {
+	swapSlot[vpn] = swapMap->Find();
+	ASSERT(swapSlot[vpn] != -1);		// out of swap space
+    }
+    DEBUG('a', "Swapping out page %d to slot %d\n", vpn, swapSlot[vpn]);
+    numWritten = swapFile->WriteAt(frame, PageSize, swapSlot[vpn] * PageSize);
+    ASSERT(numWritten == PageSize);
+    stats->numPageOuts++;
+    pageTable[vpn].dirty = false;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::SyncTLB
+// 	The TLB holds copies of page table entries, and the hardware sets
+//	the use and dirty bits in the copies only.  Fold them back into
+//	the page table, so that the kernel knows which pages are dirty.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::SyncTLB()
+{
+    for (int i = 0; i < TLBSize; i++) {
+	TranslationEntry *entry = &machine->tlb[i];
+
+	if (!entry->valid || entry->asid != asid)
+	    continue;
+	pageTable[entry->virtualPage].use |= entry->use;
+	pageTable[entry->virtualPage].dirty |= entry->dirty;
+    }
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::IsCodePage
+// 	Return TRUE if virtual page "vpn" lies within the code segment,
+//	and shares no bytes with the data segments.  Such a page is the
+//	same in every process running the program, and is never 
+//	written, so the processes can share one frame for it (cf. 
+//	PhysMemoryManager::AllocFrame).
+//----------------------------------------------------------------------
+
+static bool
+Overlaps(Segment *seg, int virtAddr, int size)
+{
+    return seg->size > 0 && seg->virtualAddr < virtAddr + size && 
+		virtAddr < seg->virtualAddr + seg->size;
+}
+
+bool
+AddrSpace::IsCodePage(int vpn)
+{
+    NoffHeader *noffH = &program->noffH;
+    int virtAddr = vpn * PageSize;
+
+    return virtAddr >= noffH->code.virtualAddr && 
+	virtAddr + PageSize <= noffH->code.virtualAddr + noffH->code.size &&
+	!Overlaps(&noffH->initData, virtAddr, PageSize) &&
+	!Overlaps(&noffH->uninitData, virtAddr, PageSize);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::ProgramId
+// 	Return a number that tells the executable we run from any other:
+//	the sector of its file header.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::ProgramId()
+{
+    return program->file->headSector;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::AddFile
+// 	Enter "file", which the program has just opened, in its open 
+//	file table.  Return the OpenFileId the program should use for 
+//	it, or -1 if it has too many files open; the caller then closes
+//	the file.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::AddFile(OpenFile *file)
+{
+    for (int id = FirstFileId; id < MaxOpenFiles; id++)
+	if (openFiles[id] == NULL) {
+	    openFiles[id] = file;
+	    return id;
+	}
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::FindFile
+// 	Return the file the program has open as "id", or NULL if "id" is
+//	not that of an open file (or is that of the console).
+//----------------------------------------------------------------------
+
+OpenFile *
+AddrSpace::FindFile(int id)
+{
+    if (id < FirstFileId || id >= MaxOpenFiles)
+	return NULL;
+    return openFiles[id];
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CloseFile
+// 	Close the file the program has open as "id", and free the id.
+//	Return FALSE if no file is open as "id".
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::CloseFile(int id)
+{
+    OpenFile *file = FindFile(id);
+
+    if (file == NULL)
+	return FALSE;
+    openFiles[id] = NULL;
+    delete file;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CopyOnWrite
+// 	The running process wrote to virtual page "vpn", which is 
+//	read-only.  If the page is copy-on-write, let the process write
+//	to it from now on -- in a frame of its own, if another process
+//	still shares the frame (cf. PhysMemoryManager::Unshare) -- and 
+//	return TRUE, so that the instruction is retried.  Otherwise the
+//	write is an error, and we return FALSE.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::CopyOnWrite(int vpn)
+{
+    if (vpn < 0 || vpn >= (int) numPages || !copyOnWrite[vpn])
+	return FALSE;
+    ASSERT(pageTable[vpn].valid);		// the TLB maps it
+    physMemoryManager->Unshare(this, vpn);
+    pageTable[vpn].readOnly = false;
+    copyOnWrite[vpn] = false;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::FaultRate
+// 	Return the number of page faults taken per 1000 user instructions
+//	(of any process) executed since this address space was created.
+//----------------------------------------------------------------------
+
+double
+AddrSpace::FaultRate()
+{
+    int ticks = stats->userTicks - startTick;
+
+    if (ticks == 0)
+	return 0;
+    return 1000.0 * numFaults / ticks;
+}
+
 //----------------------------------------------------------------------
 // AddrSpace::SaveState
 // 	On a context switch, save any machine state, specific
 //	to this address space, that needs saving.
 //
-//	For now, nothing!
+//	Keep the use and dirty bits the TLB has collected for us, while
+//	we are not running to see them.
 //----------------------------------------------------------------------
 
 void AddrSpace::SaveState() 
-{}
+{
+    SyncTLB();
+}
 
 //----------------------------------------------------------------------
 // AddrSpace::RestoreState
 // 	On a context switch, restore the machine state so that
 //	this address space can run.
 //
-//      For now, tell the machine where to find the page table.
+//      The TLB entries of this space are tagged with its ASID, so they
+//	can stay in the TLB while other spaces run; just tell the machine
+//	which ASID to match.  Only the simulator's fast translations,
+//	which are not tagged, must go.
 //----------------------------------------------------------------------
 
 void AddrSpace::RestoreState() 
 {
 //    machine->pageTable = pageTable;
 //	machine->pageTableSize = numPages;
-	int i;
-	for (i = 0; i < TLBSize; i++) {
-		DEBUG('f', "aa\n");
-		machine->tlb[i].valid = false;
-	}
+	machine->currentASID = asid;
+	machine->FlushFastTranslations();
 	DEBUG('a', "%s Addr:Space finishes\n", currentThread->getName());
 }
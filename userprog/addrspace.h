@@ -15,14 +15,48 @@
 
 #include "copyright.h"
 #include "filesys.h"
+#include "noff.h"
 
 #define UserStackSize		1024 	// increase this as necessary!
+#define MaxOpenFiles		16	// per process, counting the console
+#define FirstFileId		2	// 0 and 1 are the console (cf. 
+					// ConsoleInput in syscall.h)
+
+#ifdef FILESYS
+#include "disk.h"
+#define NumSwapPages	(NumSectors / 4 * SectorSize / PageSize)
+					// a quarter of the disk
+#else
+#define NumSwapPages	256
+#endif
+
+// The executable file of a user program, and the header that says 
+// where its segments are.  The pages of a program are read from it as
+// they are touched, so it stays open as long as any address space 
+// running the program -- the one that loaded it, and any forked
+// from that one -- still exists.
+
+class Program {
+  public:
+    Program(OpenFile *executable);	// Read the header of "executable";
+					// the program keeps (and
+					// eventually deletes) the file
+    ~Program();
+
+    OpenFile *file;			// the program, read a page at a time
+    NoffHeader noffH;			// where its segments are
+    int refs;				// address spaces using it
+};
 
 class AddrSpace {
   public:
     AddrSpace(OpenFile *executable);	// Create an address space,
 					// initializing it with the program
-					// stored in the file "executable"
+					// stored in the file "executable";
+					// the address space keeps (and
+					// eventually deletes) the file
+    AddrSpace(AddrSpace *parent);	// Create a copy of "parent", 
+					// sharing its pages copy-on-write
     ~AddrSpace();			// De-allocate an address space
 
     void InitRegisters();		// Initialize user-level CPU registers,
@@ -30,14 +64,57 @@ class AddrSpace {
 
     void SaveState();			// Save/restore address space-specific
     void RestoreState();		// info on a context switch 
+
+    void LoadPage(int vpn, char *frame);	// Fill a page frame with
+					// the contents of virtual page "vpn"
+    void SavePage(int vpn, char *frame);	// Write "vpn" to swap if it
+					// is dirty; its frame is being reused
+    void SyncTLB();			// Copy the use and dirty bits of
+					// the TLB back into the page table
+    bool IsCodePage(int vpn);		// Does "vpn" hold nothing but code?
+    int ProgramId();			// Which executable file we run
+    int AddFile(OpenFile *file);	// Enter "file" in the open file 
+					// table; return its id, or -1 if 
+					// the table is full
+    OpenFile *FindFile(int id);		// The file open as "id", or NULL
+    bool CloseFile(int id);		// Close the file open as "id"
+
+    bool CopyOnWrite(int vpn);		// Give "vpn" a private copy, after
+					// a write to it faulted; FALSE if
+					// it is not copy-on-write
 	
+	double FaultRate();			// Page faults per 1000 user
+					// instructions, since creation
+
 	bool isInited;
+
+    int residentPages;			// page frames held
+    int frameQuota;			// page frames it may hold; 0 when
+					// not yet admitted, or suspended
+    int wantedQuota;			// quota to ask for on admission
+    int numFaults;			// page faults taken
+    int lastFaultTick;			// stats->userTicks at the last one
+    int startTick;			// stats->userTicks at creation
+    bool suspended;			// swapped out to make room?
+    int asid;				// address space identifier, which
+					// tags our TLB entries
+    int pid;				// process identifier (the SpaceId
+					// of syscall.h), -1 if none yet
+
 //for convenice in lab5  private:
     TranslationEntry *pageTable;	// Assume linear page table translation
 					// for now!
     unsigned int numPages;		// Number of pages in the virtual 
 					// address space
-	char *virDisk;	//virtual disk, add in lab5
+
+  private:
+    Program *program;			// what we are running
+    bool *copyOnWrite;			// is the page shared with a
+					// parent or child, until written?
+    int *swapSlot;			// page of the swap file holding
+					// each virtual page, -1 if none
+    OpenFile *openFiles[MaxOpenFiles];	// the files the program has 
+					// open, by OpenFileId
 };
 
 #endif // ADDRSPACE_H
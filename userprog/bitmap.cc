@@ -2,6 +2,13 @@
 //	Routines to manage a bitmap -- an array of bits each of which
 //	can be either on or off.  Represented as an array of integers.
 //
+//	Searches skip a word of set (or clear) bits at a time, and find
+//	the bit they want in a word by counting its trailing zeros; the
+//	number of clear bits is kept up to date, rather than counted.
+//	Allocation is next-fit: each search starts where the last one
+//	left off, so that the bits just before, likely all set, are not
+//	looked at again and again.
+//
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -22,8 +29,10 @@ BitMap::BitMap(int nitems)
     numBits = nitems;
     numWords = divRoundUp(numBits, BitsInWord);
     map = new unsigned int[numWords];
-    for (int i = 0; i < numBits; i++) 
-        Clear(i);
+    for (int i = 0; i < numWords; i++) 
+        map[i] = 0;
+    Recount();
+    rotor = 0;
 }
 
 //----------------------------------------------------------------------
@@ -33,7 +42,7 @@ BitMap::BitMap(int nitems)
 
 BitMap::~BitMap()
 { 
-    delete map;
+    delete [] map;
 }
 
 //----------------------------------------------------------------------
@@ -46,8 +55,13 @@ BitMap::~BitMap()
 void
 BitMap::Mark(int which) 
 { 
+    unsigned int bit = 1u << (which % BitsInWord);
+
     ASSERT(which >= 0 && which < numBits);
-    map[which / BitsInWord] |= 1 << (which % BitsInWord);
+    if (!(map[which / BitsInWord] & bit)) {
+	map[which / BitsInWord] |= bit;
+	numClear--;
+    }
 }
     
 //----------------------------------------------------------------------
@@ -60,8 +74,13 @@ BitMap::Mark(int which)
 void 
 BitMap::Clear(int which) 
 {
+    unsigned int bit = 1u << (which % BitsInWord);
+
     ASSERT(which >= 0 && which < numBits);
-    map[which / BitsInWord] &= ~(1 << (which % BitsInWord));
+    if (map[which / BitsInWord] & bit) {
+	map[which / BitsInWord] &= ~bit;
+	numClear++;
+    }
 }
 
 //----------------------------------------------------------------------
@@ -82,9 +101,78 @@ BitMap::Test(int which)
 	return FALSE;
 }
 
+//----------------------------------------------------------------------
+// BitMap::NextClear
+// 	Return the number of the first clear bit at or after "from", or 
+//	-1 if there is none.  (The bits past the end are set, so they are
+//	never found.)
+//----------------------------------------------------------------------
+
+int
+BitMap::NextClear(int from)
+{
+    int w = from / BitsInWord;
+    unsigned int bits;
+
+    if (from >= numBits)
+	return -1;
+    bits = ~map[w] & (~0u << (from % BitsInWord));
+    while (bits == 0) {
+	if (++w == numWords)
+	    return -1;
+	bits = ~map[w];
+    }
+    return w * BitsInWord + __builtin_ctz(bits);
+}
+
+//----------------------------------------------------------------------
+// BitMap::NextSet
+// 	Return the number of the first set bit at or after "from", or
+//	numBits if there is none.
+//----------------------------------------------------------------------
+
+int
+BitMap::NextSet(int from)
+{
+    int w = from / BitsInWord;
+    unsigned int bits;
+
+    if (from >= numBits)
+	return numBits;
+    bits = map[w] & (~0u << (from % BitsInWord));
+    while (bits == 0) {
+	if (++w == numWords)
+	    return numBits;
+	bits = map[w];
+    }
+    return min(w * BitsInWord + __builtin_ctz(bits), numBits);
+}
+
+//----------------------------------------------------------------------
+// BitMap::Search
+// 	Return the number of the first bit of the first run of "n" clear
+//	bits at or after "from", or -1 if there is none.  Each run of 
+//	clear bits too short for the request costs two word scans: one
+//	for its start, and one for its end.
+//----------------------------------------------------------------------
+
+int
+BitMap::Search(int from, int n)
+{
+    int start, end;
+
+    for (start = NextClear(from); start != -1; start = NextClear(end)) {
+	end = NextSet(start);
+	if (end - start >= n)
+	    return start;
+    }
+    return -1;
+}
+
 //----------------------------------------------------------------------
 // BitMap::Find
-// 	Return the number of the first bit which is clear.
+// 	Return the number of a bit which is clear -- the first one after
+//	the bit last allocated, wrapping around at the end of the map.
 //	As a side effect, set the bit (mark it as in use).
 //	(In other words, find and allocate a bit.)
 //
@@ -94,14 +182,105 @@ BitMap::Test(int which)
 int 
 BitMap::Find() 
 {
-    for (int i = 0; i < numBits; i++)
-	if (!Test(i)) {
-	    Mark(i);
-	    return i;
+    int which;
+
+    if (numClear == 0)
+	return -1;
+    if ((which = NextClear(rotor)) == -1)
+	which = NextClear(0);
+    Mark(which);
+    rotor = which + 1;
+    return which;
+}
+
+//----------------------------------------------------------------------
+// BitMap::FindRun
+// 	Find "n" consecutive clear bits, in the same next-fit order as 
+//	Find, and set them.  Return the number of the first of them, or
+//	-1 if there is no run that long.
+//----------------------------------------------------------------------
+
+int
+BitMap::FindRun(int n)
+{
+    int start;
+
+    ASSERT(n > 0);
+    if (numClear < n)
+	return -1;
+    if ((start = Search(rotor, n)) == -1 && (start = Search(0, n)) == -1)
+	return -1;
+    MarkRun(start, n);
+    rotor = start + n;
+    return start;
+}
+
+//----------------------------------------------------------------------
+// BitMap::FindRun
+// 	Find "n" consecutive clear bits among bits "from" to "to" - 1, 
+//	the first such run, and set them.  Return the number of the 
+//	first of them, or -1 if there is no run that long in the range.
+//	Used to keep an allocation within, say, one disk track.
+//----------------------------------------------------------------------
+
+int
+BitMap::FindRun(int n, int from, int to)
+{
+    int start, end;
+
+    ASSERT(n > 0 && from >= 0 && to <= numBits);
+    for (start = NextClear(from); start != -1 && start + n <= to; 
+	    start = NextClear(end)) {
+	end = min(NextSet(start), to);
+	if (end - start >= n) {
+	    MarkRun(start, n);
+	    return start;
 	}
+    }
     return -1;
 }
 
+//----------------------------------------------------------------------
+// BitMap::MarkRun, BitMap::ClearRun
+// 	Set (clear) the "n" bits starting with the "nth", a word at a time.
+//----------------------------------------------------------------------
+
+static unsigned int
+RunMask(int bit, int count)		// "count" bits from "bit" on
+{
+    return (count == BitsInWord) ? ~0u : ((1u << count) - 1) << bit;
+}
+
+void
+BitMap::MarkRun(int which, int n)
+{
+    int count;
+    unsigned int mask;
+
+    ASSERT(which >= 0 && n >= 0 && which + n <= numBits);
+    for (; n > 0; which += count, n -= count) {
+	count = min(n, BitsInWord - which % BitsInWord);
+	mask = RunMask(which % BitsInWord, count);
+	numClear -= __builtin_popcount(mask & ~map[which / BitsInWord]);
+	map[which / BitsInWord] |= mask;
+    }
+}
+
+void
+BitMap::ClearRun(int which, int n)
+{
+    int count;
+    unsigned int mask;
+
+    ASSERT(which >= 0 && n >= 0 && which + n <= numBits);
+    for (; n > 0; which += count, n -= count) {
+	count = min(n, BitsInWord - which % BitsInWord);
+	mask = RunMask(which % BitsInWord, count);
+	numClear += __builtin_popcount(mask & map[which / BitsInWord]);
+	map[which / BitsInWord] &= ~mask;
+    }
+}
+
 //----------------------------------------------------------------------
 // BitMap::NumClear
 // 	Return the number of clear bits in the bitmap.
@@ -111,11 +290,24 @@ BitMap::Find()
 int 
 BitMap::NumClear() 
 {
-    int count = 0;
+    return numClear;
+}
 
-    for (int i = 0; i < numBits; i++)
-	if (!Test(i)) count++;
-    return count;
+//----------------------------------------------------------------------
+// BitMap::Recount
+// 	Set the bits past the end of the map, which are not to be found,
+//	and count the clear ones.  Called when the contents of the map 
+//	are replaced wholesale.
+//----------------------------------------------------------------------
+
+void
+BitMap::Recount()
+{
+    if (numBits % BitsInWord != 0)
+	map[numWords - 1] |= ~0u << (numBits % BitsInWord);
+    numClear = numWords * BitsInWord;
+    for (int i = 0; i < numWords; i++)
+	numClear -= __builtin_popcount(map[i]);
 }
 
 //----------------------------------------------------------------------
@@ -149,6 +341,8 @@ void
 BitMap::FetchFrom(OpenFile *file) 
 {
     file->ReadAt((char *)map, numWords * sizeof(unsigned), 0);
+    Recount();
+    rotor = 0;
 }
 
 //----------------------------------------------------------------------
@@ -3,7 +3,8 @@
 //	can be either on or off.
 //
 //	Represented as an array of unsigned integers, on which we do
-//	modulo arithmetic to find the bit we are interested in.
+//	modulo arithmetic to find the bit we are interested in.  Searches
+//	look at a whole word at a time.
 //
 //	The bitmap can be parameterized with with the number of bits being 
 //	managed.
@@ -43,6 +44,11 @@ class BitMap {
     int Find();            	// Return the # of a clear bit, and as a side
 				// effect, set the bit. 
 				// If no bits are clear, return -1.
+    int FindRun(int n);		// The same, for "n" consecutive clear
+				// bits: return the # of the first
+    int FindRun(int n, int from, int to);	// The same, but only
+				// among bits "from" to "to" - 1
+    void ClearRun(int which, int n);	// Clear "n" bits from the "nth"
     int NumClear();		// Return the number of clear bits
 
     void Print();		// Print contents of bitmap
@@ -58,7 +64,20 @@ class BitMap {
 					// (rounded up if numBits is not a
 					//  multiple of the number of bits in
 					//  a word)
-    unsigned int *map;			// bit storage
+    unsigned int *map;			// bit storage; the bits past 
+					// numBits in the last word are set
+    int numClear;			// number of clear bits
+    int rotor;				// where the next search starts
+
+    int NextClear(int from);		// first clear bit from "from" on,
+					// or -1
+    int NextSet(int from);		// first set bit from "from" on, or
+					// numBits
+    int Search(int from, int n);	// first run of "n" clear bits from
+					// "from" on, or -1
+    void MarkRun(int which, int n);	// set "n" bits from the "nth"
+    void Recount();			// compute numClear, after the map
+					// was read in
 };
 
 #endif // BITMAP_H
@@ -4,8 +4,7 @@
 //	transfer back to here from user code:
 //
 //	syscall -- The user code explicitly requests to call a procedure
-//	in the Nachos kernel.  Right now, the only function we support is
-//	"Halt".
+//	in the Nachos kernel: any of those in syscall.h.
 //
 //	exceptions -- The user code does something that the CPU can't handle.
 //	For instance, accessing memory that doesn't exist, arithmetic errors,
@@ -14,8 +13,8 @@
 //	Interrupts (which can also cause control to transfer from user
 //	code into the Nachos kernel) are handled elsewhere.
 //
-// For now, this only handles the Halt() system call.
-// Everything else core dumps.
+// Besides system calls, we handle TLB misses and writes to copy-on-write
+// pages.  Everything else core dumps.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -24,6 +23,584 @@
 #include "copyright.h"
 #include "system.h"
 #include "syscall.h"
+#include "console.h"
+#include "synch.h"
+
+#define MaxProcesses	64		// processes that can exist at once
+#define NoParent	-1		// parent of a process no one can join
+#define MaxNameLength	128		// longest file name a program can pass
+#define SyscallBufferSize (8 * PageSize)	// bytes of a Read or Write
+					// moved through the kernel at once
+
+// A process, as its parent sees it through Exec, Fork and Join.  The
+// entry outlives the process, to keep its exit status until the parent
+// joins it (or exits itself).
+
+class Process {
+  public:
+    Process(int parentId) { parent = parentId; exited = FALSE; status = 0;
+			    done = new Condition("process done"); }
+    ~Process() { delete done; }
+
+    int parent;				// the process that may join it
+    bool exited;			// has it called Exit?
+    int status;				// if so, with what status
+    Condition *done;			// the processes waiting in Join
+};
+
+static Process *processes[MaxProcesses];	// by SpaceId
+static Lock *processLock;		// protects "processes"
+
+static Console *console;		// opened at the first Read or Write
+static Semaphore *consoleReadAvail;	// of ConsoleInput or ConsoleOutput
+static Semaphore *consoleWriteDone;
+static Lock *consoleLock;		// one Read or Write at a time
+
+//----------------------------------------------------------------------
+// TLBMiss
+// 	Virtual page "vpn" of the running process is not in the TLB: load
+//	its translation, reading in the page if it is not in memory.
+//	Return FALSE if the page is outside the address space.
+//----------------------------------------------------------------------
+
+static bool
+TLBMiss(int vpn)
+{
+    if (vpn < 0 || vpn >= (int) currentThread->space->numPages)
+	return FALSE;
+    machine->tlbMiss_LRU(vpn); 
+    stats->numTLBMisses++;
+    stats->processTLBMisses[machine->currentASID]++;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// UserToPhys
+// 	Return the physical address of the user virtual address 
+//	"virtAddr", as the hardware would translate it for a load (or a 
+//	store, if "writing"), handling TLB misses and copy-on-write 
+//	faults along the way.  Return -1 if the program has no right to
+//	the address.
+//
+//	The translation holds only until the kernel next blocks, which
+//	may let another process evict the page.
+//----------------------------------------------------------------------
+
+static int
+UserToPhys(int virtAddr, bool writing)
+{
+    ExceptionType exception;
+    int physAddr, vpn = (unsigned) virtAddr / PageSize;
+
+    for (;;) {
+	exception = machine->Translate(virtAddr, &physAddr, 1, writing);
+	if (exception == NoException)
+	    return physAddr;
+	if (exception == PageFaultException) {
+	    if (!TLBMiss(vpn))
+		return -1;
+	} else if (exception != ReadOnlyException || 
+		!currentThread->space->CopyOnWrite(vpn))
+	    return -1;
+    }
+}
+
+//----------------------------------------------------------------------
+// CopyFromUser, CopyToUser
+// 	Copy "size" bytes between user virtual address "virtAddr" and 
+//	the kernel buffer "buf".  Rather than a ReadMem or WriteMem per 
+//	byte, each page of the user buffer is translated once, and 
+//	copied with memcpy.  Return FALSE if the user buffer is not 
+//	entirely within the address space (or, for CopyToUser, not
+//	writable); some of it may have been copied.
+//----------------------------------------------------------------------
+
+static bool
+CopyFromUser(int virtAddr, char *buf, int size)
+{
+    int physAddr, chunk;
+
+    while (size > 0) {
+	chunk = min(size, PageSize - virtAddr % PageSize);
+	if ((physAddr = UserToPhys(virtAddr, FALSE)) == -1)
+	    return FALSE;
+	memcpy(buf, &machine->mainMemory[physAddr], chunk);
+	virtAddr += chunk;
+	buf += chunk;
+	size -= chunk;
+    }
+    return TRUE;
+}
+
+static bool
+CopyToUser(char *buf, int virtAddr, int size)
+{
+    int physAddr, chunk;
+
+    while (size > 0) {
+	chunk = min(size, PageSize - virtAddr % PageSize);
+	if ((physAddr = UserToPhys(virtAddr, TRUE)) == -1)
+	    return FALSE;
+	memcpy(&machine->mainMemory[physAddr], buf, chunk);
+	machine->InvalidateFrameDecoded(physAddr / PageSize);
+	virtAddr += chunk;
+	buf += chunk;
+	size -= chunk;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// CopyStringFromUser
+// 	Copy the null-terminated string at user virtual address 
+//	"virtAddr" into "buf", which holds "size" bytes, a page at a time.
+//	Return FALSE if the string is not entirely in the address space,
+//	or is too long.
+//----------------------------------------------------------------------
+
+static bool
+CopyStringFromUser(int virtAddr, char *buf, int size)
+{
+    int physAddr, chunk, i;
+
+    while (size > 0) {
+	chunk = min(size, PageSize - virtAddr % PageSize);
+	if ((physAddr = UserToPhys(virtAddr, FALSE)) == -1)
+	    return FALSE;
+	for (i = 0; i < chunk; i++)
+	    if ((*buf++ = machine->mainMemory[physAddr + i]) == '\0')
+		return TRUE;
+	virtAddr += chunk;
+	size -= chunk;
+    }
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// OpenConsole
+// 	Set up the console, the first time a program reads or writes it.
+//	(Opening it sooner would keep Nachos from ever running out of 
+//	things to do, since the console polls for input.)
+//----------------------------------------------------------------------
+
+static void ConsoleReadAvail(int arg) { consoleReadAvail->V(); }
+static void ConsoleWriteDone(int arg) { consoleWriteDone->V(); }
+
+static void
+OpenConsole()
+{
+    if (console != NULL)
+	return;
+    consoleReadAvail = new Semaphore("console read avail", 0);
+    consoleWriteDone = new Semaphore("console write done", 0);
+    consoleLock = new Lock("console");
+    console = new Console(NULL, NULL, ConsoleReadAvail, ConsoleWriteDone, 0);
+}
+
+//----------------------------------------------------------------------
+// CurrentProcess
+// 	Return the SpaceId of the running process, giving it one (with no
+//	parent) if it was not started by Exec or Fork.
+//----------------------------------------------------------------------
+
+static int NewProcess(int parent);
+
+static int
+CurrentProcess()
+{
+    AddrSpace *space = currentThread->space;
+
+    if (space->pid == -1) {
+	space->pid = NewProcess(NoParent);
+	ASSERT(space->pid != -1);		// too many processes
+    }
+    return space->pid;
+}
+
+//----------------------------------------------------------------------
+// NewProcess
+// 	Make an entry in the process table for a process started by
+//	"parent", and return its SpaceId; or -1 if the table is full.
+//----------------------------------------------------------------------
+
+static int
+NewProcess(int parent)
+{
+    if (processLock == NULL)
+	processLock = new Lock("processes");
+    for (int pid = 0; pid < MaxProcesses; pid++)
+	if (processes[pid] == NULL) {
+	    processes[pid] = new Process(parent);
+	    return pid;
+	}
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// RunProcess
+// 	Give "space" the SpaceId "pid", and run it in a new thread, which
+//	starts with "func" (cf. ExecProcess, ForkedProcess).  Return "pid".
+//----------------------------------------------------------------------
+
+static int
+RunProcess(AddrSpace *space, int pid, VoidFunctionPtr func, int arg)
+{
+    Thread *thread = new Thread("user process");
+
+    space->pid = pid;
+    thread->space = space;
+    thread->SaveUserState();		// the parent's registers, which
+					// a forked child starts from
+    thread->Fork(func, arg);
+    return pid;
+}
+
+//----------------------------------------------------------------------
+// ExecProcess
+// 	The first thing a thread created by the Exec system call does:
+//	start running its program from the beginning.
+//----------------------------------------------------------------------
+
+static void
+ExecProcess(int arg)
+{
+    currentThread->space->InitRegisters();
+    currentThread->space->RestoreState();
+    machine->Run();
+    ASSERT(FALSE);			// machine->Run never returns
+}
+
+//----------------------------------------------------------------------
+// ForkedProcess
+// 	The first thing a thread created by the Fork system call does: 
+//	start running its address space, at the address of the procedure
+//	"func", with the rest of its registers as its parent left them
+//	(cf. SysFork).  Being new, the thread has to load its own user
+//	state; the scheduler only reloads that of threads it switches 
+//	back to.
+//----------------------------------------------------------------------
+
+static void
+ForkedProcess(int func)
+{
+    currentThread->RestoreUserState();
+    machine->WriteRegister(PCReg, func);
+    machine->WriteRegister(NextPCReg, func + 4);
+    currentThread->space->RestoreState();
+    machine->Run();
+    ASSERT(FALSE);			// machine->Run never returns
+}
+
+//----------------------------------------------------------------------
+// SysExec
+// 	Start a child process running the program in the file named at
+//	user address "nameAddr".  Return its SpaceId, or -1 if the
+//	program cannot be opened or there are too many processes.
+//----------------------------------------------------------------------
+
+static int
+SysExec(int nameAddr)
+{
+    char name[MaxNameLength];
+    OpenFile *executable;
+    int parent = CurrentProcess(), pid;
+
+    if (!CopyStringFromUser(nameAddr, name, MaxNameLength))
+	return -1;
+    if ((executable = fileSystem->Open(name)) == NULL)
+	return -1;
+    if ((pid = NewProcess(parent)) == -1) {
+	delete executable;
+	return -1;
+    }
+    DEBUG('a', "Exec %s as process %d\n", name, pid);
+    return RunProcess(new AddrSpace(executable), pid, ExecProcess, 0);
+}
+
+//----------------------------------------------------------------------
+// SysFork
+// 	Start a child process running the procedure at address "func",
+//	in a copy of the address space of the running process -- its 
+//	code, data and stack, shared page by page until one of the two
+//	writes to a page (cf. AddrSpace::CopyOnWrite).  The child 
+//	starts with the registers of the parent, stack pointer included,
+//	so "func" runs on (a copy of) the parent's stack.  Return the
+//	child's SpaceId, or -1 if there are too many processes.
+//----------------------------------------------------------------------
+
+static int
+SysFork(int func)
+{
+    int parent = CurrentProcess(), pid;
+
+    if ((pid = NewProcess(parent)) == -1)
+	return -1;
+    DEBUG('a', "Forking process %d at 0x%x\n", pid, func);
+    return RunProcess(new AddrSpace(currentThread->space), pid, 
+			ForkedProcess, func);
+}
+
+//----------------------------------------------------------------------
+// SysJoin
+// 	Wait until the child process "pid" has exited, and return its
+//	exit status; the SpaceId is then free to be reused.  Return -1
+//	if "pid" is not a child of the running process.
+//----------------------------------------------------------------------
+
+static int
+SysJoin(int pid)
+{
+    int self = CurrentProcess(), status;
+    Process *child;
+
+    if (pid < 0 || pid >= MaxProcesses || processes[pid] == NULL || 
+	    processes[pid]->parent != self)
+	return -1;
+    child = processes[pid];
+    processLock->Acquire();
+    while (!child->exited)
+	child->done->Wait(processLock);
+    status = child->status;
+    processes[pid] = NULL;
+    delete child;
+    processLock->Release();
+    return status;
+}
+
+//----------------------------------------------------------------------
+// SysExit
+// 	The running process is done.  Record its status for its parent;
+//	free the entries of its children that have exited, since no one
+//	can join them now; and delete its address space.  When the last
+//	process exits, there is nothing left to do: halt.
+//----------------------------------------------------------------------
+
+static void
+SysExit(int status)
+{
+    AddrSpace *space = currentThread->space;
+    int self = CurrentProcess();
+    Process *process = processes[self];
+    int i;
+
+    DEBUG('a', "Process %d exits with status %d\n", self, status);
+    processLock->Acquire();
+    for (i = 0; i < MaxProcesses; i++)
+	if (processes[i] != NULL && processes[i]->parent == self) {
+	    if (processes[i]->exited) {
+		delete processes[i];
+		processes[i] = NULL;
+	    } else
+		processes[i]->parent = NoParent;
+	}
+    if (process->parent == NoParent) {
+	processes[self] = NULL;
+	delete process;
+    } else {
+	process->exited = TRUE;
+	process->status = status;
+	process->done->Broadcast(processLock);
+    }
+    processLock->Release();
+
+    currentThread->space = NULL;
+    delete space;
+    for (i = 0; i < NumASIDs && asidTable[i] == NULL; i++)
+	;
+    if (i == NumASIDs)
+	interrupt->Halt();
+    currentThread->Finish();
+}
+
+//----------------------------------------------------------------------
+// SysCreate, SysOpen, SysClose
+// 	The file system operations on whole files.  Open returns the new
+//	OpenFileId, or -1 on failure; so do Create and Close (0 for 
+//	success), although syscall.h does not promise a result.
+//----------------------------------------------------------------------
+
+static int
+SysCreate(int nameAddr)
+{
+    char name[MaxNameLength];
+
+    if (!CopyStringFromUser(nameAddr, name, MaxNameLength) ||
+	    !fileSystem->Create(name, 0))
+	return -1;
+    return 0;
+}
+
+static int
+SysOpen(int nameAddr)
+{
+    char name[MaxNameLength];
+    OpenFile *file;
+    int id;
+
+    if (!CopyStringFromUser(nameAddr, name, MaxNameLength) ||
+	    (file = fileSystem->Open(name)) == NULL)
+	return -1;
+    if ((id = currentThread->space->AddFile(file)) == -1)
+	delete file;
+    return id;
+}
+
+static int
+SysClose(int id)
+{
+    return currentThread->space->CloseFile(id) ? 0 : -1;
+}
+
+//----------------------------------------------------------------------
+// SysRead
+// 	Read up to "size" bytes from the open file "id" into the user
+//	buffer at "bufAddr", and return how many were read, or -1 on 
+//	error.  The bytes go through a kernel buffer, SyscallBufferSize
+//	at a time: the file is read first (which may block), and only 
+//	then the user pages are found, so that they cannot be evicted
+//	before they are filled.  
+//
+//	The console returns at most a line, and waits for at least one
+//	character.
+//----------------------------------------------------------------------
+
+static int
+SysRead(int bufAddr, int size, int id)
+{
+    char buf[SyscallBufferSize];
+    OpenFile *file;
+    int total = 0, chunk, numRead;
+
+    if (size < 0)
+	return -1;
+    if (id == ConsoleInput) {
+	OpenConsole();
+	consoleLock->Acquire();
+	for (numRead = 0; numRead < min(size, SyscallBufferSize); ) {
+	    consoleReadAvail->P();
+	    buf[numRead] = console->GetChar();
+	    if (buf[numRead++] == '\n')
+		break;
+	}
+	consoleLock->Release();
+	return CopyToUser(buf, bufAddr, numRead) ? numRead : -1;
+    }
+    if ((file = currentThread->space->FindFile(id)) == NULL)
+	return -1;
+    while (total < size) {
+	chunk = min(size - total, SyscallBufferSize);
+	numRead = file->Read(buf, chunk);
+	if (!CopyToUser(buf, bufAddr + total, numRead))
+	    return -1;
+	total += numRead;
+	if (numRead < chunk)		// end of file
+	    break;
+    }
+    return total;
+}
+
+//----------------------------------------------------------------------
+// SysWrite
+// 	Write "size" bytes from the user buffer at "bufAddr" to the open
+//	file "id", through a kernel buffer as for Read, and return how
+//	many were written, or -1 on error.
+//----------------------------------------------------------------------
+
+static int
+SysWrite(int bufAddr, int size, int id)
+{
+    char buf[SyscallBufferSize];
+    OpenFile *file = NULL;
+    int total = 0, chunk, numWritten, i;
+
+    if (size < 0 || (id != ConsoleOutput && 
+	    (file = currentThread->space->FindFile(id)) == NULL))
+	return -1;
+    while (total < size) {
+	chunk = min(size - total, SyscallBufferSize);
+	if (!CopyFromUser(bufAddr + total, buf, chunk))
+	    return -1;
+	if (file == NULL) {
+	    OpenConsole();
+	    consoleLock->Acquire();
+	    for (i = 0; i < chunk; i++) {
+		console->PutChar(buf[i]);
+		consoleWriteDone->P();
+	    }
+	    consoleLock->Release();
+	    numWritten = chunk;
+	} else
+	    numWritten = file->Write(buf, chunk);
+	total += numWritten;
+	if (numWritten < chunk)		// the file is full
+	    break;
+    }
+    return total;
+}
+
+//----------------------------------------------------------------------
+// SystemCall
+// 	Carry out system call "type", with the arguments in r4-r7, and
+//	put the result (if any) in r2.  The time each kind of system call
+//	takes is added up in the statistics.
+//
+//	The simulator moves the PC past the syscall instruction once we
+//	return (cf. Machine::Execute), so we must not advance it here.
+//	Exit does not return, and neither does Halt.
+//----------------------------------------------------------------------
+
+static void
+SystemCall(int type)
+{
+    int arg1 = machine->ReadRegister(4);
+    int arg2 = machine->ReadRegister(5);
+    int arg3 = machine->ReadRegister(6);
+    int start = stats->totalTicks, result = 0;
+
+    if (type >= 0 && type < MaxSyscallStats)
+	stats->syscallCalls[type]++;
+    switch (type) {
+      case SC_Halt:
+	DEBUG('a', "Shutdown, initiated by user program.\n");
+	interrupt->Halt();
+	break;
+      case SC_Exit:
+	SysExit(arg1);
+	break;
+      case SC_Exec:
+	result = SysExec(arg1);
+	break;
+      case SC_Join:
+	result = SysJoin(arg1);
+	break;
+      case SC_Create:
+	result = SysCreate(arg1);
+	break;
+      case SC_Open:
+	result = SysOpen(arg1);
+	break;
+      case SC_Read:
+	result = SysRead(arg1, arg2, arg3);
+	break;
+      case SC_Write:
+	result = SysWrite(arg1, arg2, arg3);
+	break;
+      case SC_Close:
+	result = SysClose(arg1);
+	break;
+      case SC_Fork:
+	result = SysFork(arg1);
+	break;
+      case SC_Yield:
+	currentThread->Yield();
+	break;
+      default:
+	printf("Unexpected system call %d\n", type);
+	ASSERT(FALSE);
+    }
+    machine->WriteRegister(2, result);
+    stats->syscallTicks[type] += stats->totalTicks - start;
+}
 
 //----------------------------------------------------------------------
 // ExceptionHandler
@@ -41,8 +618,8 @@
 //
 //	The result of the system call, if any, must be put back into r2. 
 //
-// And don't forget to increment the pc before returning. (Or else you'll
-// loop making the same system call forever!
+// The pc is incremented past the syscall instruction by the simulator,
+// once we return (cf. SystemCall).
 //
 //	"which" is the kind of exception.  The list of possible exceptions 
 //	are in machine.h.
@@ -54,14 +631,15 @@ ExceptionHandler(ExceptionType which)
 {
     int type = machine->ReadRegister(2);
 
-    if ((which == SyscallException) && (type == SC_Halt)) {
-		DEBUG('a', "Shutdown, initiated by user program.\n");
-   		interrupt->Halt();
-    } else if (which == PageFaultException) {
-		int virAddr = machine->ReadRegister(BadVAddrReg);
-		int vpn = virAddr/PageSize;
-		machine->tlbMiss_LRU(vpn); 
-		stats->numPageFaults++;
+    if (which == SyscallException) {
+		SystemCall(type);
+    } else if (which == ReadOnlyException && 
+	    currentThread->space->CopyOnWrite(
+			machine->ReadRegister(BadVAddrReg) / PageSize)) {
+		;				// retry the write
+    } else if (which == PageFaultException && 
+	    TLBMiss(machine->ReadRegister(BadVAddrReg) / PageSize)) {
+		;				// retry the reference
 	} else {
 		printf("Unexpected user mode exception %d %d\n", which, type);
 		ASSERT(FALSE);
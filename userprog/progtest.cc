@@ -23,7 +23,6 @@ void forkThread(int which) {
 	currentThread->space = space2;
 	space2->InitRegisters();
 	space2->RestoreState();
-	delete file2;
 
 	machine->Run();
 }
@@ -45,10 +44,9 @@ StartProcess(char *filename)
     }
 
 	machine->tlb[0].valid = false;
-	space = new AddrSpace(executable);    
+	space = new AddrSpace(executable);	// the space closes the file
     currentThread->space = space;
 	machine->tlb[0].valid = false;
-    delete executable;			// close file
 
     space->InitRegisters();		// set the initial register values
     space->RestoreState();		// load page table register
@@ -65,6 +63,51 @@ StartProcess(char *filename)
 					// by doing the syscall "exit"
 }
 
+//----------------------------------------------------------------------
+// ExecBenchmark
+// 	Measure how long it takes to set up the address space of a user
+//	program, in simulated ticks and disk reads.  Pages are read in as
+//	the program touches them, so this is the cost of the header and
+//	of the page the program starts on.  The first load finds
+//	the buffer cache cold; the average is over the loads after it.
+//----------------------------------------------------------------------
+
+#define ExecBenchmarkLoads	10
+
+void
+ExecBenchmark(char *filename)
+{
+    OpenFile *executable;
+    AddrSpace *space;
+    char page[PageSize];
+    int ticks, reads, warmTicks = 0, warmReads = 0;
+
+    for (int i = 0; i < ExecBenchmarkLoads; i++) {
+	ticks = stats->totalTicks;
+	reads = stats->numDiskReads;
+	executable = fileSystem->Open(filename);
+	if (executable == NULL) {
+	    printf("Unable to open file %s\n", filename);
+	    return;
+	}
+	space = new AddrSpace(executable);
+	space->LoadPage(0, page);
+	delete space;			// also closes the file
+	ticks = stats->totalTicks - ticks;
+	reads = stats->numDiskReads - reads;
+	if (i == 0)
+	    printf("Exec startup, cold: %d ticks, %d disk reads\n", 
+		ticks, reads);
+	else {
+	    warmTicks += ticks;
+	    warmReads += reads;
+	}
+    }
+    printf("Exec startup, warm: %d ticks, %d disk reads (average of %d)\n",
+	warmTicks / (ExecBenchmarkLoads - 1), 
+	warmReads / (ExecBenchmarkLoads - 1), ExecBenchmarkLoads - 1);
+}
+
 // Data structures needed for the console test.  Threads making
 // I/O requests wait on a Semaphore to delay until the I/O completes.
 
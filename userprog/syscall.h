@@ -114,10 +114,14 @@ void Close(OpenFileId id);
  * threads to run within a user program. 
  */
 
-/* Fork a thread to run a procedure ("func") in the *same* address space 
- * as the current thread.
+/* Fork a child process to run a procedure ("func") in a *copy* of the
+ * address space of the current thread, stack included.  The copy is
+ * made page by page, copy-on-write, so it costs little until the 
+ * parent or the child writes to memory.  Return the address space 
+ * identifier of the child, which the parent can Join; "func" should 
+ * end by calling Exit.
  */
-void Fork(void (*func)());
+SpaceId Fork(void (*func)());
 
 /* Yield the CPU to another runnable thread, whether in this address space 
  * or not. 